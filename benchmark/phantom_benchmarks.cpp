@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Microbenchmarks of the per-tick and per-message hot paths. Everything runs
+ * on the simulated device and a local tf::Transformer, so neither OpenHaptics
+ * nor a ROS master is needed. Compare ns per call against the 1 ms servo
+ * period before and after a change.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+#include <tf/tf.h>
+
+#include "sensable_phantom/kalman_estimator.h"
+#include "sensable_phantom/phantom_kinematics.h"
+#include "sensable_phantom/phantom_ros.h"
+#include "sensable_phantom/phantom_state.h"
+#include "sensable_phantom/sim_backend.h"
+#include "sensable_phantom/velocity_filter.h"
+
+namespace sensable_phantom
+{
+
+// The only door into PhantomROS internals the benchmarks use
+class PhantomROSBenchmark
+{
+public:
+  static void set_sensable_transform(PhantomROS& phantom_ros, const tf::Transform& transform)
+  {
+    phantom_ros.sensable_transform_ = transform;
+  }
+
+  static void sample_pose(const PhantomROS& phantom_ros, const PhantomSample& sample, geometry_msgs::Pose& pose)
+  {
+    phantom_ros.sample_pose(sample, pose);
+  }
+
+  // What init() sets up for wrench_callback; damping_k in N/(mm/s), like the parameter
+  static void setup_wrench(PhantomROS& phantom_ros, PhantomState *state, double damping_k,
+                           const std::string& target_frame, const std::vector<std::string>& static_frames)
+  {
+    phantom_ros.state_ = state;
+    phantom_ros.damping_k_ = damping_k;
+    phantom_ros.wrench_frames_.set_target_frame(target_frame);
+    for (size_t i = 0; i < static_frames.size(); i++)
+      phantom_ros.wrench_frames_.add_static_frame(static_frames[i]);
+  }
+};
+
+} // namespace sensable_phantom
+
+using namespace sensable_phantom;
+
+// Slowly moving stylus, so the estimators see realistic input
+static void trajectory(unsigned long k, double position[3])
+{
+  double t = k * 1e-3;
+  position[0] = 60.0 * sin(2 * M_PI * 0.2 * t);
+  position[1] = 40.0 * sin(2 * M_PI * 0.4 * t);
+  position[2] = 30.0 * sin(2 * M_PI * 0.6 * t);
+}
+
+// Velocity estimate of phantom_state_callback, by filter order
+static void BM_VelocityFilterStep(benchmark::State& state)
+{
+  VelocityFilter filter;
+  filter.configure(state.range(0), 20.0, 1000.0);
+  double position[3], velocity[3];
+  unsigned long k = 0;
+  for (auto _ : state)
+  {
+    trajectory(k++, position);
+    filter.step(position, velocity);
+    benchmark::DoNotOptimize(velocity);
+  }
+}
+BENCHMARK(BM_VelocityFilterStep)->Arg(1)->Arg(3)->Arg(8);
+
+static void BM_KalmanStep(benchmark::State& state)
+{
+  KalmanEstimator kalman;
+  kalman.configure(1000.0, 4e9, 0.03);
+  double position[3], velocity[3], acceleration[3];
+  unsigned long k = 0;
+  for (auto _ : state)
+  {
+    trajectory(k++, position);
+    kalman.step(position, velocity, acceleration);
+    benchmark::DoNotOptimize(velocity);
+    benchmark::DoNotOptimize(acceleration);
+  }
+}
+BENCHMARK(BM_KalmanStep);
+
+// Whole servo callback on the simulated device, without scheduler sleeps
+static void BM_ServoTick(benchmark::State& state)
+{
+  SimBackend backend((SimConfig()));
+  PhantomState phantom;
+  phantom.device = backend.open("");
+  phantom.servo_rate = backend.update_rate();
+  phantom.velocity_filter.configure(3, 20.0, phantom.servo_rate);
+  phantom.stats.configure(phantom.servo_rate, 0.1);
+  PhantomCommand command;
+  memset(&command, 0, sizeof(command));
+  phantom.command.write(command);
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(phantom_state_callback(&phantom));
+}
+BENCHMARK(BM_ServoTick);
+
+// link_0 -> sensable_origin -> stylus, as published on NAME/pose
+static void BM_SamplePose(benchmark::State& state)
+{
+  tf::Transformer transformer;
+  PhantomROS phantom_ros(transformer);
+  PhantomROSBenchmark::set_sensable_transform(
+      phantom_ros, tf::Transform(tf::createQuaternionFromRPY(M_PI / 2, 0, -M_PI / 2), tf::Vector3(-0.2, 0, 0)));
+
+  PhantomSample sample;
+  memset(&sample, 0, sizeof(sample));
+  double joints[3] = {0.2, 0.4, -0.3};
+  double gimbal[3] = {0.3, -0.2, 0.1};
+  double position[3] = {10.0, 20.0, -30.0};
+  stylus_transform(joints, gimbal, position, sample.transform);
+
+  geometry_msgs::Pose pose;
+  for (auto _ : state)
+  {
+    PhantomROSBenchmark::sample_pose(phantom_ros, sample, pose);
+    benchmark::DoNotOptimize(pose);
+  }
+}
+BENCHMARK(BM_SamplePose);
+
+// Force feedback message handling; argument 0 sends from a static frame
+// (cached rotation), 1 from a dynamic one (tf lookup per message)
+static void BM_WrenchCallback(benchmark::State& state)
+{
+  tf::Transformer transformer;
+  ros::Time stamp(1.0);
+  tf::Transform identity = tf::Transform::getIdentity();
+  tf::Transform sensable(tf::createQuaternionFromRPY(M_PI / 2, 0, -M_PI / 2), tf::Vector3(-0.2, 0, 0));
+  tf::Transform tool(tf::createQuaternionFromRPY(0.1, 0.2, 0.3), tf::Vector3(0.1, 0, 0.2));
+  transformer.setTransform(tf::StampedTransform(identity, stamp, "base_link", "link_0"));
+  transformer.setTransform(tf::StampedTransform(sensable, stamp, "link_0", "sensable_origin"));
+  transformer.setTransform(tf::StampedTransform(tool, stamp, "base_link", "tool"));
+
+  PhantomState phantom;
+  PhantomROS phantom_ros(transformer);
+  std::vector<std::string> static_frames;
+  static_frames.push_back("base_link");
+  static_frames.push_back("link_0");
+  PhantomROSBenchmark::setup_wrench(phantom_ros, &phantom, 0.001, "sensable_origin", static_frames);
+
+  geometry_msgs::WrenchStampedPtr wrench(new geometry_msgs::WrenchStamped);
+  wrench->header.frame_id = state.range(0) ? "tool" : "base_link";
+  wrench->wrench.force.x = 0.5;
+  wrench->wrench.force.y = -0.2;
+  wrench->wrench.force.z = 1.0;
+  geometry_msgs::WrenchStampedConstPtr message = wrench;
+
+  for (auto _ : state)
+    phantom_ros.wrench_callback(message);
+}
+BENCHMARK(BM_WrenchCallback)->Arg(0)->Arg(1);
+
+int main(int argc, char **argv)
+{
+  // tf and the servo stamps use ROS time, but nothing connects to a master
+  ros::Time::init();
+  benchmark::Initialize(&argc, argv);
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
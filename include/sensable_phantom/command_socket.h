@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Low-latency force command path. Forces arrive as fixed-size UDP datagrams
+ * and are read by the servo callback itself with a non-blocking recv(2), so
+ * they bypass the roscpp queue, the spinner and wrench_callback entirely.
+ * Every packet carries the sender's CLOCK_REALTIME stamp; the servo loop
+ * zeroes the force once the latest packet is older than the timeout.
+ */
+
+#ifndef SENSABLE_PHANTOM_COMMAND_SOCKET_H
+#define SENSABLE_PHANTOM_COMMAND_SOCKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <atomic>
+#include <string>
+
+namespace sensable_phantom
+{
+
+inline int64_t realtime_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Wire format, host byte order (little-endian on every supported platform).
+// Force and torque are in sensable_origin, N and Nm. Every field is naturally
+// aligned, so the layout has no padding without packing.
+struct CommandPacket
+{
+  static const uint32_t MAGIC = 0x4d434850; // "PHCM"
+
+  uint32_t magic;
+  uint32_t seq; // free for the sender, e.g. loss accounting
+  int64_t stamp_ns; // sender CLOCK_REALTIME, ns since epoch
+  double force[3];
+  double torque[3];
+};
+static_assert(sizeof(CommandPacket) == 64, "CommandPacket wire format changed");
+
+// Checks size, magic and that every number is finite, then copies data into
+// packet. Returns false for anything that must not reach the servo loop.
+bool parse_command_packet(const void *data, size_t size, CommandPacket& packet);
+
+class CommandSocket
+{
+public:
+  CommandSocket();
+  ~CommandSocket();
+
+  // Recv calls per receive(), so a flood cannot stall the servo tick
+  static const int MAX_PACKETS_PER_RECEIVE = 8;
+
+  // Binds a UDP socket to address:port. Packets stamped more than tolerance_ns
+  // ahead of the local clock are rejected. Returns 0 on success.
+  int open(const std::string& address, int port, int64_t tolerance_ns);
+  void close();
+
+  bool valid() const
+  {
+    return fd_ >= 0;
+  }
+
+  // Servo thread only. Reads up to MAX_PACKETS_PER_RECEIVE pending datagrams
+  // without blocking and keeps the newest valid one. Returns true if packet
+  // was updated.
+  bool receive(CommandPacket& packet);
+
+  // Datagrams dropped for bad size/magic/numbers, an older stamp or a stamp
+  // in the future
+  unsigned long rejected() const
+  {
+    return rejected_.load(std::memory_order_relaxed);
+  }
+
+private:
+  int fd_;
+  int64_t tolerance_ns_;
+  int64_t last_stamp_ns_;
+  std::atomic<unsigned long> rejected_; // written by the servo thread only
+
+  CommandSocket(const CommandSocket&);
+  CommandSocket& operator=(const CommandSocket&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_COMMAND_SOCKET_H
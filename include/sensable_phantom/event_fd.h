@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Wakes a ROS thread from the servo thread. notify() is a single
+ * non-blocking write(2) on an eventfd, so the servo side never waits.
+ */
+
+#ifndef SENSABLE_PHANTOM_EVENT_FD_H
+#define SENSABLE_PHANTOM_EVENT_FD_H
+
+#include <errno.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace sensable_phantom
+{
+
+class EventFd
+{
+public:
+  EventFd() : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+  {
+  }
+
+  ~EventFd()
+  {
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  bool valid() const
+  {
+    return fd_ >= 0;
+  }
+
+  void notify()
+  {
+    uint64_t one = 1;
+    ssize_t ret = write(fd_, &one, sizeof(one));
+    (void)ret; // EAGAIN only if the counter is saturated, reader is awake anyway
+  }
+
+  // Waits up to timeout_ms for notifications. Returns how many arrived since
+  // the last wait, 0 on timeout.
+  uint64_t wait(int timeout_ms)
+  {
+    struct pollfd pfd;
+    pfd.fd = fd_;
+    pfd.events = POLLIN;
+    if (poll(&pfd, 1, timeout_ms) <= 0)
+      return 0;
+
+    uint64_t count = 0;
+    if (read(fd_, &count, sizeof(count)) != sizeof(count))
+      return 0;
+    return count;
+  }
+
+private:
+  int fd_;
+
+  EventFd(const EventFd&);
+  EventFd& operator=(const EventFd&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_EVENT_FD_H
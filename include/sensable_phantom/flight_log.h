@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Flight-data log of every servo tick. The servo callback pushes a fixed-size
+ * record into a lock-free ring and never touches the file; a background
+ * thread drains the ring into a file that was preallocated for the expected
+ * session length and grows in large steps past it. The file is written
+ * through a small mapped window that slides along it, so an hour-long log
+ * does not take an hour of address space, nor of locked memory when the
+ * process runs with mlockall(MCL_FUTURE).
+ *
+ * File layout: one FlightLogHeader followed by header.count FlightLogRecords,
+ * host byte order. The header count is kept up to date while logging, so a
+ * file left behind by a crash is readable up to the last drain.
+ */
+
+#ifndef SENSABLE_PHANTOM_FLIGHT_LOG_H
+#define SENSABLE_PHANTOM_FLIGHT_LOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/thread/thread.hpp>
+
+#include "sensable_phantom/lockfree.h"
+
+namespace sensable_phantom
+{
+
+struct FlightLogRecord
+{
+  uint64_t tick;
+  int64_t stamp_ns; // CLOCK_MONOTONIC time the device was read
+  double position[3]; // mm, sensable_origin
+  double velocity[3]; // mm/s, as estimated
+  double transform[16]; // column-major, as reported by the device
+  double joints[3]; // rad
+  double gimbal[3]; // rad
+  double force[3]; // N, as written to the device
+  double torque[3]; // Nm, as written to the device
+  int32_t buttons; // BUTTON_1 | BUTTON_2
+  int32_t error; // device error code of the tick, 0 if none
+};
+
+struct FlightLogHeader
+{
+  static const uint32_t VERSION = 1;
+
+  char magic[8]; // "PHNTMLOG"
+  uint32_t version;
+  uint32_t record_size; // sizeof(FlightLogRecord)
+  uint64_t count; // records that follow
+  double servo_rate; // nominal, Hz
+  // Both clocks at open time, to put the monotonic stamps on the wall clock
+  int64_t start_realtime_ns;
+  int64_t start_monotonic_ns;
+  char name[64]; // device namespace
+  char model[32]; // device model
+  char reserved[112];
+};
+
+static_assert(sizeof(FlightLogRecord) == 296, "FlightLogRecord layout changed");
+static_assert(sizeof(FlightLogHeader) == 256, "FlightLogHeader layout changed");
+
+extern const char FLIGHT_LOG_MAGIC[8];
+
+// Reads a whole log written by FlightLogger. Returns 0 on success.
+int read_flight_log(const std::string& path, FlightLogHeader& header, std::vector<FlightLogRecord>& records);
+
+// About eight seconds at 1 kHz before the servo loop starts dropping records
+typedef SpscRing<FlightLogRecord, 8192> FlightLogQueue;
+
+class FlightLogger
+{
+public:
+  FlightLogger();
+  // Stops and closes
+  ~FlightLogger();
+
+  // Creates path, preallocated for duration seconds at servo_rate. Returns 0
+  // on success.
+  int open(const std::string& path, double duration, double servo_rate, const std::string& name,
+           const std::string& model);
+
+  // Drains queue() into the file until stop()
+  void start();
+  // Writes what is still queued, trims the file to its content and closes it
+  void stop();
+
+  FlightLogQueue& queue()
+  {
+    return queue_;
+  }
+
+  const std::string& path() const
+  {
+    return path_;
+  }
+
+  // Records in the file
+  uint64_t written() const
+  {
+    return written_.load(std::memory_order_relaxed);
+  }
+
+  // Set when the file could not grow; the records that follow are lost
+  bool failed() const
+  {
+    return failed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  void loop();
+  // Drains the queue; returns the number of records written
+  size_t drain();
+  // Makes room for at least one more record. Returns 0 on success.
+  int grow();
+  // Maps the window holding the record at file offset. Returns 0 on success.
+  int map_window(uint64_t offset);
+  void close();
+
+  FlightLogQueue queue_;
+  std::string path_;
+  int fd_;
+  FlightLogHeader *header_; // mapped on its own
+  char *window_;
+  uint64_t window_offset_; // file offset of window_, page aligned
+  uint64_t capacity_; // records the file has room for
+  uint64_t grow_step_; // records added when the file is full
+
+  boost::thread thread_;
+  std::atomic<bool> running_;
+  std::atomic<uint64_t> written_;
+  std::atomic<bool> failed_;
+
+  FlightLogger(const FlightLogger&);
+  FlightLogger& operator=(const FlightLogger&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_FLIGHT_LOG_H
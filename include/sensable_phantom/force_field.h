@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Force field plugins evaluated by the servo loop. Plugins are pluginlib
+ * classes derived from ForceField, loaded at startup and chained in the
+ * order given in ~force_fields. Each one has a budget; its execution time is
+ * measured every tick and a plugin that keeps exceeding the budget is
+ * disabled. Parameters can be changed at run time on
+ * NAME/force_field_parameters and reach the servo loop through a triple
+ * buffer.
+ */
+
+#ifndef SENSABLE_PHANTOM_FORCE_FIELD_H
+#define SENSABLE_PHANTOM_FORCE_FIELD_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pluginlib/class_loader.h>
+#include <ros/ros.h>
+
+#include "sensable_phantom/lockfree.h"
+#include "sensable_phantom/servo_stats.h"
+
+namespace sensable_phantom
+{
+
+// Device state handed to the plugins, in sensable_origin
+struct ForceFieldInput
+{
+  unsigned long tick;
+  double dt; // nominal servo period, s
+  double position[3]; // mm
+  double velocity[3]; // mm/s
+  double acceleration[3]; // mm/s^2, zero unless estimated
+  double gimbal[3]; // rad
+  double joints[3]; // rad
+  int buttons[2];
+};
+
+// Named run-time parameters of one plugin; fixed size so it fits a TripleBuffer
+struct ForceFieldParameters
+{
+  static const int MAX = 16;
+  static const int NAME_LENGTH = 32;
+
+  int count;
+  char names[MAX][NAME_LENGTH];
+  double values[MAX];
+
+  // Declares a parameter; returns its index or -1 if there is no room
+  int add(const std::string& name, double value);
+  // Index of name or -1
+  int find(const std::string& name) const;
+};
+
+class ForceField
+{
+public:
+  virtual ~ForceField()
+  {
+  }
+
+  // ROS side, once, before the servo loop. pnode is the plugin's private
+  // namespace. Declare the run-time parameters with their initial values in
+  // parameters; they are passed to configure() before the first update().
+  // Returns 0 on success.
+  virtual int initialize(const ros::NodeHandle& pnode, ForceFieldParameters& parameters) = 0;
+
+  // Servo thread, whenever parameters changed
+  virtual void configure(const ForceFieldParameters& parameters) = 0;
+
+  // Servo thread, every tick. Adds force (N) and torque (Nm) to the output.
+  // Must not block, allocate, log or throw.
+  virtual void update(const ForceFieldInput& in, double force[3], double torque[3]) = 0;
+};
+
+class ForceFieldChain
+{
+public:
+  ForceFieldChain();
+  ~ForceFieldChain();
+
+  // Loads the plugins listed in ~force_fields. Plugin NAME is created from
+  // ~NAME/type with budget ~NAME/budget (s) and its own parameters in ~NAME.
+  // Returns 0 on success, also when no plugins are configured.
+  int load(const ros::NodeHandle& pnode);
+
+  bool empty() const
+  {
+    return fields_.empty();
+  }
+
+  // ROS side. Sets the named parameters of plugin field; returns false and
+  // logs if the plugin or a parameter does not exist.
+  bool set_parameters(const std::string& field, const std::vector<std::string>& names,
+                      const std::vector<double>& values);
+
+  // Servo thread. Runs the enabled plugins in order on top of force and torque.
+  void update(const ForceFieldInput& in, double force[3], double torque[3]);
+
+  struct Status
+  {
+    std::string name;
+    bool enabled;
+    int64_t budget_ns;
+    unsigned long overruns; // ticks over budget, total
+    HistogramSnapshot execution;
+  };
+  // ROS side
+  void status(std::vector<Status>& status) const;
+
+private:
+  struct Field
+  {
+    std::string name;
+    boost::shared_ptr<ForceField> plugin;
+    int64_t budget_ns;
+    int overrun_limit; // consecutive overruns before the plugin is disabled
+
+    ForceFieldParameters parameters; // ROS side copy
+    boost::mutex parameters_mutex; // producers of the mailbox
+    TripleBuffer<ForceFieldParameters> mailbox; // ROS -> servo
+
+    std::atomic<bool> enabled; // cleared by the servo thread
+    int consecutive; // servo thread only
+    std::atomic<unsigned long> overruns;
+    LatencyHistogram execution;
+  };
+
+  pluginlib::ClassLoader<ForceField> loader_;
+  std::vector<Field *> fields_;
+
+  ForceFieldChain(const ForceFieldChain&);
+  ForceFieldChain& operator=(const ForceFieldChain&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_FORCE_FIELD_H
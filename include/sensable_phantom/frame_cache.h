@@ -0,0 +1,56 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Rotates incoming wrenches into the device frame. For frames that are known
+ * to be static w.r.t. the target (this node's own chain and any frames listed
+ * by the user) the rotation is looked up once and cached, so the per-message
+ * cost is a 3x3 matrix multiply instead of two tf buffer searches.
+ */
+
+#ifndef SENSABLE_PHANTOM_FRAME_CACHE_H
+#define SENSABLE_PHANTOM_FRAME_CACHE_H
+
+#include <set>
+#include <string>
+
+#include <boost/thread/mutex.hpp>
+#include <tf/tf.h>
+
+namespace sensable_phantom
+{
+
+class FrameCache
+{
+public:
+  explicit FrameCache(const tf::Transformer& transformer);
+
+  void set_target_frame(const std::string& frame);
+
+  // Declares frame as rigidly attached to the target frame
+  void add_static_frame(const std::string& frame);
+
+  bool is_static(const std::string& frame) const;
+
+  // Rotates force and torque from frame into the target frame, in place.
+  // Throws tf::TransformException if the transform is not available.
+  void rotate(const std::string& frame, tf::Vector3& force, tf::Vector3& torque);
+
+private:
+  static std::string normalize(const std::string& frame);
+
+  const tf::Transformer& transformer_;
+  std::string target_frame_;
+  std::set<std::string> static_frames_; // normalized
+
+  boost::mutex mutex_;
+  std::string cached_frame_; // as received, so hits need no normalization
+  tf::Matrix3x3 cached_rotation_;
+  bool cached_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_FRAME_CACHE_H
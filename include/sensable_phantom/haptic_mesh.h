@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Triangle mesh rendering inside the servo loop. A mesh is loaded and its
+ * bounding volume hierarchy built on a ROS thread, in device units
+ * (sensable_origin, mm). The servo loop then runs a god-object proxy against
+ * it: the proxy follows the stylus tip but is stopped by the surface and
+ * slides along up to three constraint planes; the force is a spring-damper
+ * pulling the tip towards the proxy.
+ */
+
+#ifndef SENSABLE_PHANTOM_HAPTIC_MESH_H
+#define SENSABLE_PHANTOM_HAPTIC_MESH_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace sensable_phantom
+{
+
+struct TriangleMesh
+{
+  std::vector<float> vertices; // x, y, z per vertex
+  std::vector<uint32_t> indices; // three vertex indices per triangle, counter-clockwise seen from outside
+
+  size_t triangles() const
+  {
+    return indices.size() / 3;
+  }
+};
+
+// Loads binary or ASCII STL and PLY files, chosen by extension. Polygons are
+// triangulated as fans. Returns 0 on success.
+int load_mesh(const std::string& path, TriangleMesh& mesh);
+
+// Servo thread state of the proxy; reset whenever the mesh changes
+struct MeshProxy
+{
+  MeshProxy() : valid(false), contact(false)
+  {
+  }
+
+  bool valid;
+  bool contact;
+  double position[3]; // mm
+};
+
+class MeshModel
+{
+public:
+  // Builds the hierarchy over mesh, which must already be in device units.
+  // stiffness in N/mm, damping in N/(mm/s).
+  MeshModel(const TriangleMesh& mesh, double stiffness, double damping);
+
+  // First front-facing triangle hit by the segment from -> to. Returns false
+  // if there is none, otherwise t in [0, 1] along the segment and the unit
+  // outward normal.
+  bool raycast(const double from[3], const double to[3], double& t, double normal[3]) const;
+
+  // Servo thread. Moves the proxy towards position and adds the contact
+  // force to force (N).
+  void render(const double position[3], const double velocity[3], MeshProxy& proxy, double force[3]) const;
+
+  size_t triangles() const
+  {
+    return triangles_.size();
+  }
+
+private:
+  // Leaves have count > 0 and own triangles_[first, first + count); inner
+  // nodes have count == 0, left child right after them and right child at first
+  struct Node
+  {
+    float min[3];
+    float max[3];
+    uint32_t first;
+    uint32_t count;
+  };
+
+  struct Triangle
+  {
+    float v0[3];
+    float e1[3]; // v1 - v0
+    float e2[3]; // v2 - v0
+  };
+
+  uint32_t build(std::vector<uint32_t>& order, const std::vector<float>& centroids, const TriangleMesh& mesh,
+                 uint32_t begin, uint32_t end);
+
+  std::vector<Node> nodes_;
+  std::vector<Triangle> triangles_;
+  double stiffness_;
+  double damping_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_HAPTIC_MESH_H
@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Analytic haptic scene rendered inside the servo loop: half-spaces,
+ * spheres and oriented boxes pushing the stylus tip out with a spring-damper.
+ * Everything is in device units (sensable_origin, mm, N) and lives in a
+ * fixed-size array, so a scene can be copied into a TripleBuffer slot and
+ * rendered without touching the heap.
+ */
+
+#ifndef SENSABLE_PHANTOM_HAPTIC_SCENE_H
+#define SENSABLE_PHANTOM_HAPTIC_SCENE_H
+
+namespace sensable_phantom
+{
+
+struct ScenePrimitive
+{
+  enum Type
+  {
+    PLANE, SPHERE, BOX
+  };
+
+  Type type;
+  double center[3]; // plane: any point on it
+  double axes[3][3]; // plane: axes[0] is the outward unit normal; box: unit axes
+  double size[3]; // sphere: radius in size[0]; box: half extents along axes
+  double stiffness; // N/mm
+  double damping; // N/(mm/s), along the contact normal only
+};
+
+struct PrimitiveScene
+{
+  static const int MAX_PRIMITIVES = 64;
+
+  int count;
+  ScenePrimitive primitives[MAX_PRIMITIVES];
+
+  // Adds the contact force for a tip at position moving with velocity
+  // (mm, mm/s) to force (N)
+  void render(const double position[3], const double velocity[3], double force[3]) const;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_HAPTIC_SCENE_H
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Constant-acceleration Kalman estimator for the stylus position. Each axis
+ * has state [p, v, a] driven by white jerk and observes p only. Noise and
+ * sampling are the same for all axes, so one covariance and one gain serve
+ * all three; a step is a few dozen multiply-adds on fixed-size arrays.
+ */
+
+#ifndef SENSABLE_PHANTOM_KALMAN_ESTIMATOR_H
+#define SENSABLE_PHANTOM_KALMAN_ESTIMATOR_H
+
+namespace sensable_phantom
+{
+
+class KalmanEstimator
+{
+public:
+  KalmanEstimator();
+
+  // rate in Hz; jerk_psd is the white jerk spectral density, position units^2/s^5;
+  // position_sigma is the measurement noise std, position units. Returns 0 on
+  // success, -1 if any argument is not positive. Resets the estimate.
+  int configure(double rate, double jerk_psd, double position_sigma);
+
+  // Next step() starts from rest at the position it is given
+  void reset();
+
+  // One servo tick. Velocity and acceleration are in position units per
+  // second and per second squared.
+  void step(const double position[3], double velocity[3], double acceleration[3]);
+
+private:
+  double dt_;
+  double q_[3][3]; // process noise over one step
+  double r_; // measurement variance
+
+  bool primed_;
+  double x_[3][3]; // [axis][p, v, a]
+  double p_[3][3]; // shared covariance
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_KALMAN_ESTIMATOR_H
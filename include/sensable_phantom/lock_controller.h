@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Holds the stylus where it was when the lock engaged: a spring-damper
+ * towards the captured position, saturated at a maximum force and faded in
+ * over a ramp so engaging never jerks the arm. Runs in the servo loop, in
+ * device units (sensable_origin, mm, N).
+ */
+
+#ifndef SENSABLE_PHANTOM_LOCK_CONTROLLER_H
+#define SENSABLE_PHANTOM_LOCK_CONTROLLER_H
+
+namespace sensable_phantom
+{
+
+struct LockGains
+{
+  LockGains();
+
+  double stiffness; // N/mm
+  double damping; // N/(mm/s)
+  double max_force; // N
+  double ramp_time; // s from engage to full force; 0 applies it at once
+};
+
+class LockController
+{
+public:
+  LockController();
+
+  // Servo thread, every tick. Captures position when locked goes from false
+  // to true. Returns true while engaged, with the holding force in force.
+  bool update(bool locked, const LockGains& gains, const double position[3], const double velocity[3], double dt,
+              double force[3]);
+
+  bool engaged() const
+  {
+    return engaged_;
+  }
+
+  // Where the stylus is held, mm
+  const double* anchor() const
+  {
+    return anchor_;
+  }
+
+private:
+  bool engaged_;
+  double anchor_[3];
+  double elapsed_; // s since engaged
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_LOCK_CONTROLLER_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Lock-free primitives used to exchange data between the haptic servo thread
+ * and the ROS threads. The servo side of every primitive is wait-free, so the
+ * 1 kHz scheduler callback never blocks on a ROS thread.
+ */
+
+#ifndef SENSABLE_PHANTOM_LOCKFREE_H
+#define SENSABLE_PHANTOM_LOCKFREE_H
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+namespace sensable_phantom
+{
+
+/*
+ * Single writer, multiple readers sequence lock.
+ *
+ * The writer never waits. Readers retry until they get a copy that was not
+ * overwritten in the middle. The payload is kept in atomic words, so the
+ * concurrent copy is not a data race. T must be trivially copyable.
+ */
+template <typename T>
+class Seqlock
+{
+public:
+  Seqlock() : seq_(0)
+  {
+    T zero;
+    memset(&zero, 0, sizeof(T));
+    store(zero);
+  }
+
+  // Writer side (wait-free). Must be called from one thread only.
+  void store(const T& value)
+  {
+    uint64_t buf[WORDS];
+    buf[WORDS - 1] = 0;
+    memcpy(buf, &value, sizeof(T));
+
+    unsigned long seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++)
+      words_[i].store(buf[i], std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Reader side. Returns the sequence number of the copy, which grows by two
+  // with every store, so readers can tell whether new data arrived.
+  unsigned long load(T& value) const
+  {
+    uint64_t buf[WORDS];
+    unsigned long seq0, seq1;
+    do
+    {
+      seq0 = seq_.load(std::memory_order_acquire);
+      while (seq0 & 1)
+        seq0 = seq_.load(std::memory_order_acquire);
+      for (size_t i = 0; i < WORDS; i++)
+        buf[i] = words_[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      seq1 = seq_.load(std::memory_order_relaxed);
+    } while (seq0 != seq1);
+
+    memcpy(&value, buf, sizeof(T));
+    return seq0;
+  }
+
+  unsigned long sequence() const
+  {
+    return seq_.load(std::memory_order_acquire);
+  }
+
+private:
+  static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  std::atomic<unsigned long> seq_;
+  std::atomic<uint64_t> words_[WORDS];
+
+  Seqlock(const Seqlock&);
+  Seqlock& operator=(const Seqlock&);
+};
+
+/*
+ * Single producer, single consumer triple buffer.
+ *
+ * Both sides are wait-free: the producer always has a slot to write into and
+ * the consumer always reads the most recent complete value. Intermediate
+ * values may be skipped, which is what we want for commands.
+ */
+template <typename T>
+class TripleBuffer
+{
+public:
+  TripleBuffer() : back_(1), front_(0), write_(2)
+  {
+    memset(slots_, 0, sizeof(slots_));
+  }
+
+  // Slot owned by the producer. Fill it and then call publish().
+  T& write_slot()
+  {
+    return slots_[write_];
+  }
+
+  void publish()
+  {
+    write_ = back_.exchange(write_ | DIRTY, std::memory_order_acq_rel) & INDEX;
+  }
+
+  void write(const T& value)
+  {
+    write_slot() = value;
+    publish();
+  }
+
+  // Consumer side. Returns true if a new value was published since the last
+  // call; value always receives the latest one.
+  bool read(T& value)
+  {
+    bool fresh = false;
+    if (back_.load(std::memory_order_relaxed) & DIRTY)
+    {
+      front_ = back_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+      fresh = true;
+    }
+    value = slots_[front_];
+    return fresh;
+  }
+
+  // Consumer side without the copy, for large T: swaps in the latest value
+  // if there is one and returns true if so. front() stays valid and
+  // unchanged until the next update().
+  bool update()
+  {
+    if (!(back_.load(std::memory_order_relaxed) & DIRTY))
+      return false;
+    front_ = back_.exchange(front_, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  const T& front() const
+  {
+    return slots_[front_];
+  }
+
+private:
+  static const unsigned DIRTY = 0x4;
+  static const unsigned INDEX = 0x3;
+
+  T slots_[3];
+  std::atomic<unsigned> back_;
+  unsigned front_; // consumer owned
+  unsigned write_; // producer owned
+
+  TripleBuffer(const TripleBuffer&);
+  TripleBuffer& operator=(const TripleBuffer&);
+};
+
+/*
+ * Bounded single producer, single consumer FIFO. Capacity must be a power of
+ * two. push() fails instead of overwriting when the consumer falls behind.
+ */
+template <typename T, size_t Capacity>
+class SpscRing
+{
+public:
+  SpscRing() : head_(0), tail_(0)
+  {
+  }
+
+  // Producer side
+  bool push(const T& value)
+  {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == Capacity)
+      return false;
+    slots_[head & MASK] = value;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side
+  bool pop(T& value)
+  {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire))
+      return false;
+    value = slots_[tail & MASK];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  size_t size() const
+  {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+  }
+
+  static size_t capacity()
+  {
+    return Capacity;
+  }
+
+private:
+  static const size_t MASK = Capacity - 1;
+  static_assert((Capacity & MASK) == 0, "SpscRing capacity must be a power of two");
+
+  // Producer and consumer indices on separate cache lines
+  std::atomic<size_t> head_;
+  char pad_[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail_;
+  T slots_[Capacity];
+
+  SpscRing(const SpscRing&);
+  SpscRing& operator=(const SpscRing&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_LOCKFREE_H
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Recycles published messages. A message published as a shared_ptr may
+ * still be held by intra-process subscribers or queued for a connection, so
+ * it is only reused once the pool holds the last reference. With enough
+ * messages in the pool, steady-state publishing allocates nothing and
+ * nodelets still get the messages without a copy. A subscriber that never
+ * lets go can grow the pool only up to its cap; past it, messages are
+ * allocated per publish and dropped after use.
+ */
+
+#ifndef SENSABLE_PHANTOM_MESSAGE_POOL_H
+#define SENSABLE_PHANTOM_MESSAGE_POOL_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+namespace sensable_phantom
+{
+
+// Single-threaded: one publisher thread acquires from a pool. The counters
+// may be read from any thread.
+template <typename M>
+class MessagePool
+{
+public:
+  MessagePool() : max_size_(0), next_(0), misses_(0), overflows_(0)
+  {
+  }
+
+  // Fills the pool with size copies of prototype, e.g. with the frame id
+  // already set, and lets it grow up to max_size. Constant fields keep their
+  // values across reuse.
+  void init(size_t size, const M& prototype, size_t max_size)
+  {
+    prototype_ = prototype;
+    messages_.clear();
+    max_size_ = max_size > size ? max_size : size;
+    messages_.reserve(max_size_);
+    for (size_t i = 0; i < size; i++)
+      messages_.push_back(boost::shared_ptr<M>(new M(prototype)));
+    next_ = 0;
+  }
+
+  // A message nobody else holds any more. If all of them are still in use
+  // the pool grows by one, so a slow subscriber costs one allocation; a full
+  // pool hands out a message it does not keep.
+  boost::shared_ptr<M> acquire()
+  {
+    for (size_t n = 0; n < messages_.size(); n++)
+    {
+      const boost::shared_ptr<M>& message = messages_[next_];
+      next_ = (next_ + 1) % messages_.size();
+      if (message.unique())
+        return message;
+    }
+
+    increment(misses_);
+    if (messages_.size() >= max_size_)
+    {
+      increment(overflows_);
+      return boost::shared_ptr<M>(new M(prototype_));
+    }
+    messages_.push_back(boost::shared_ptr<M>(new M(prototype_)));
+    return messages_.back();
+  }
+
+  size_t size() const
+  {
+    return messages_.size();
+  }
+
+  size_t max_size() const
+  {
+    return max_size_;
+  }
+
+  // Times acquire() had to allocate
+  unsigned long misses() const
+  {
+    return misses_.load(std::memory_order_relaxed);
+  }
+
+  // Of those, the ones past the cap, which were not pooled
+  unsigned long overflows() const
+  {
+    return overflows_.load(std::memory_order_relaxed);
+  }
+
+private:
+  static void increment(std::atomic<unsigned long>& counter)
+  {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  M prototype_;
+  std::vector<boost::shared_ptr<M> > messages_;
+  size_t max_size_;
+  size_t next_;
+  std::atomic<unsigned long> misses_;
+  std::atomic<unsigned long> overflows_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_MESSAGE_POOL_H
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Device abstraction used by the servo loop. The OpenHaptics backend talks to
+ * a real PHANToM through the HD API; the simulated backend runs its own 1 kHz
+ * scheduler and synthesizes motion, so the node can run without hardware. The
+ * replay backend plays recorded trajectories back.
+ */
+
+#ifndef SENSABLE_PHANTOM_PHANTOM_DEVICE_H
+#define SENSABLE_PHANTOM_PHANTOM_DEVICE_H
+
+#include <string>
+
+namespace ros
+{
+class NodeHandle;
+}
+
+namespace sensable_phantom
+{
+
+// Button bits of DeviceInput::buttons
+enum
+{
+  BUTTON_1 = 1 << 0,
+  BUTTON_2 = 1 << 1
+};
+
+// Everything read from the device in one servo tick. Units follow
+// OpenHaptics: millimeters and radians in the device (sensable_origin) frame.
+struct DeviceInput
+{
+  double position[3];
+  double transform[16]; // column-major
+  double joints[3];
+  double gimbal[3];
+  int buttons;
+};
+
+// Everything written to the device in one servo tick, in sensable_origin
+struct DeviceOutput
+{
+  double force[3]; // N
+  double torque[3]; // Nm
+  double gimbal_torque[3]; // Nm about the gimbal axes, used by 6-DoF devices instead of torque
+};
+
+// The torque written to an OpenHaptics device, in the mNm the HD API takes:
+// gimbal_torque if gimbal is set (HD_CURRENT_GIMBAL_TORQUE), torque otherwise
+// (HD_CURRENT_TORQUE). legacy_units passes torque through unscaled, as
+// earlier versions did; it goes away in the next release.
+void hd_torque(const DeviceOutput& out, bool gimbal, bool legacy_units, double torque_mnm[3]);
+
+// Scheduler callback. Return false to stop being called.
+typedef bool (*ServoCallback)(void *user_data);
+
+class PhantomDevice
+{
+public:
+  virtual ~PhantomDevice()
+  {
+  }
+
+  virtual std::string model() const = 0;
+
+  // Blocks until the device reports a valid calibration.
+  virtual void calibrate() = 0;
+
+  // Servo thread only. Every tick is begin_frame(), read(), write(),
+  // end_frame(); end_frame() returns false on a fatal scheduler error.
+  virtual void begin_frame() = 0;
+  virtual void read(DeviceInput& in) = 0;
+  virtual void write(const DeviceOutput& out) = 0;
+  virtual bool end_frame() = 0;
+
+  // Device error code raised in the last frame, fatal or not; 0 if none
+  virtual int last_error() const
+  {
+    return 0;
+  }
+
+  // Whether write() applies DeviceOutput::gimbal_torque, i.e. the device
+  // has actuated gimbal axes
+  virtual bool has_gimbal_torque() const
+  {
+    return false;
+  }
+};
+
+class PhantomBackend
+{
+public:
+  virtual ~PhantomBackend()
+  {
+  }
+
+  // Devices must be opened before start(). Returns NULL on failure; the
+  // backend keeps ownership of the device.
+  virtual PhantomDevice* open(const std::string& name) = 0;
+
+  virtual bool start() = 0;
+  virtual void stop() = 0;
+
+  // Runs callback at servo rate from the scheduler thread until it returns
+  // false or the backend is stopped.
+  virtual void schedule(ServoCallback callback, void *user_data) = 0;
+
+  // Nominal servo rate, Hz
+  virtual double update_rate() const = 0;
+
+  // Whether ticks come at the rate the device samples positions, so the
+  // measured tick rate may replace the nominal one
+  virtual bool paced() const
+  {
+    return true;
+  }
+};
+
+// Known types are "openhaptics", "sim" and "replay"; backend options are read from the
+// given (private) node handle. Returns NULL if the type is unknown or was not
+// compiled in.
+PhantomBackend* create_backend(const std::string& type, const ros::NodeHandle& nh);
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_PHANTOM_DEVICE_H
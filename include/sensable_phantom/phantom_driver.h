@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Owns everything needed to run one or more devices: the backend, and per
+ * device the servo state, the ROS interface and the publisher thread. All
+ * devices are serviced from a single scheduler callback. phantom_node and
+ * the nodelet are thin wrappers around it.
+ */
+
+#ifndef SENSABLE_PHANTOM_PHANTOM_DRIVER_H
+#define SENSABLE_PHANTOM_PHANTOM_DRIVER_H
+
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "sensable_phantom/phantom_device.h"
+#include "sensable_phantom/phantom_ros.h"
+#include "sensable_phantom/phantom_state.h"
+#include "sensable_phantom/realtime.h"
+
+namespace sensable_phantom
+{
+
+class PhantomDriver
+{
+public:
+  PhantomDriver();
+  ~PhantomDriver();
+
+  // Opens the device(s) and sets up ROS. Returns 0 on success.
+  //
+  // With ~device_names unset a single device (~device_name) uses node and
+  // pnode directly. With a list, device NAME publishes under node/NAME and
+  // reads its settings from pnode/NAME; its tf_prefix defaults to NAME.
+  int init(const ros::NodeHandle& node, const ros::NodeHandle& pnode);
+
+  // Schedules the servo callback and starts the publisher threads
+  int start();
+
+  // Stops the publisher threads and the devices
+  void stop();
+
+  // Applies the ~realtime_callback_* settings to the calling thread, so
+  // that threads it creates afterwards (e.g. an AsyncSpinner) inherit them
+  void setup_callback_thread();
+
+private:
+  struct Device
+  {
+    Device() : publishing(false), stack_prefault(0)
+    {
+    }
+
+    std::string name;
+    PhantomState state;
+    PhantomROS phantom_ros;
+    pthread_t publish_thread;
+    bool publishing;
+    size_t stack_prefault;
+  };
+
+  static void *publish_thread(void *ptr);
+
+  boost::scoped_ptr<PhantomBackend> backend_;
+  std::vector<Device *> devices_;
+  PhantomGroup group_;
+  RealtimeConfig realtime_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_PHANTOM_DRIVER_H
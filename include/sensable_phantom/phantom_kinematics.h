@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Forward kinematics of the PHANToM arm and gimbal. Every joint is a single
+ * axis rotation, so each link quaternion comes straight from one sine/cosine
+ * pair of the half joint angle, computed once per joint and cycle.
+ */
+
+#ifndef SENSABLE_PHANTOM_PHANTOM_KINEMATICS_H
+#define SENSABLE_PHANTOM_PHANTOM_KINEMATICS_H
+
+#include <string>
+
+#include <geometry_msgs/Transform.h>
+
+namespace sensable_phantom
+{
+
+// Arm lengths of a known device model, m: link_2 -> link_3 and link_3 ->
+// link_4. Returns 0 if the model is known.
+int default_link_lengths(const std::string& model, double lengths[2]);
+
+// Link i relative to link i - 1 for i = 1..6, into links[i - 1]. thetas as
+// computed by the servo loop (thetas[0] is unused).
+//
+// This chain is the gimbal convention of the hardware: with the pi offsets
+// cancelled, link_3 -> link_6 is Rx(rot[0]) Ry(rot[1]) Rz(rot[2]), and link_0
+// -> link_3 is Rz(-joints[0]) Ry(joints[2]). Everything below follows it.
+void link_transforms(const float thetas[7], const double lengths[2], geometry_msgs::Transform links[6]);
+
+// Stylus transform from joint and gimbal angles and tip position (mm),
+// column-major in sensable_origin: the axes of link_6 of link_transforms, so
+// z is the roll axis. Stands in for the device transform where there is none.
+void stylus_transform(const double joints[3], const double rot[3], const double position[3], double transform[16]);
+
+// Maps a torque on the stylus to torques about the gimbal axes, tau = J^T t.
+// The columns of the gimbal Jacobian are the axes of gimbal angles rot[0..2]
+// in the chain of link_transforms. torque is in sensable_origin and shares
+// its unit with gimbal_torque.
+void gimbal_torques(const double joints[3], const double rot[3], const double torque[3], double gimbal_torque[3]);
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_PHANTOM_KINEMATICS_H
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+/*
+ * ROS side of the driver: publishes what the servo loop produced and turns
+ * force feedback messages into servo commands. Used by both phantom_node and
+ * the PhantomNodelet.
+ */
+
+#ifndef SENSABLE_PHANTOM_PHANTOM_ROS_H
+#define SENSABLE_PHANTOM_PHANTOM_ROS_H
+
+#include <ros/ros.h>
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <geometry_msgs/WrenchStamped.h>
+#include <sensor_msgs/JointState.h>
+#include <tf2_msgs/TFMessage.h>
+#include <diagnostic_msgs/DiagnosticArray.h>
+#include <tf/transform_listener.h>
+#include <tf2_ros/static_transform_broadcaster.h>
+
+#include <atomic>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "sensable_phantom/ForceFieldUpdate.h"
+#include "sensable_phantom/HapticMesh.h"
+#include "sensable_phantom/HapticScene.h"
+#include "sensable_phantom/LockGainsUpdate.h"
+#include "sensable_phantom/PhantomButtonEvent.h"
+#include "sensable_phantom/ServoSampleBatch.h"
+#include "sensable_phantom/command_socket.h"
+#include "sensable_phantom/flight_log.h"
+#include "sensable_phantom/force_field.h"
+#include "sensable_phantom/frame_cache.h"
+#include "sensable_phantom/message_pool.h"
+#include "sensable_phantom/phantom_state.h"
+#include "sensable_phantom/servo_stats.h"
+
+namespace sensable_phantom
+{
+
+class PhantomROS
+{
+
+public:
+  ros::NodeHandlePtr node_;
+  ros::NodeHandlePtr pnode_;
+
+  ros::Publisher pose_publisher_;
+  ros::Publisher velocity_publisher_;
+  ros::Publisher acceleration_publisher_; // only with the Kalman estimator
+  ros::Publisher joint_state_publisher_;
+  ros::Publisher link_publisher_; // /tf, all links in one message
+
+  ros::Publisher button_publisher_;
+  ros::Publisher diagnostics_publisher_;
+  ros::Publisher batch_publisher_;
+  ros::Subscriber wrench_sub_;
+  ros::Subscriber scene_sub_;
+  ros::Subscriber mesh_sub_;
+  ros::Subscriber force_field_sub_;
+  ros::Subscriber lock_gains_sub_;
+  ros::Timer diagnostics_timer_;
+  std::string base_link_name_;
+  std::string sensable_frame_name_;
+  std::string link_names_[7];
+  // The names above with tf_prefix applied
+  std::string base_frame_id_;
+  std::string sensable_frame_id_;
+  std::string link_frame_ids_[7];
+
+  // Published messages are recycled, so publishing does not allocate. The
+  // cap is above the publisher queue depth, so a subscriber that only lags
+  // behind stays within it.
+  static const size_t MESSAGE_POOL_SIZE = 8;
+  static const size_t MESSAGE_POOL_MAX_SIZE = 128;
+  MessagePool<geometry_msgs::PoseStamped> pose_pool_;
+  MessagePool<geometry_msgs::Vector3Stamped> velocity_pool_;
+  MessagePool<geometry_msgs::Vector3Stamped> acceleration_pool_;
+  MessagePool<sensor_msgs::JointState> joint_state_pool_;
+  MessagePool<tf2_msgs::TFMessage> link_pool_;
+  MessagePool<PhantomButtonEvent> button_pool_;
+  MessagePool<ServoSampleBatch> batch_pool_;
+  unsigned long pool_overflows_; // as of the last diagnostics report
+
+  std::string tf_prefix_;
+  double table_offset_;
+  static const double DEFAULT_DAMPING_K; // N/(mm/s)
+  double damping_k_; // N/(mm/s)
+  bool locked_;
+  bool calibrate_;
+  int publish_rate_;
+  bool event_driven_;
+  int batch_size_;
+  bool publish_links_;
+  double link_lengths_[2]; // upper and lower arm, m
+
+  PhantomState *state_;
+  boost::scoped_ptr<tf2_ros::StaticTransformBroadcaster> static_br_; // created by init()
+  tf::Transform sensable_transform_; // link_0 -> sensable_origin
+
+private:
+  // Declared ahead of wrench_frames_, which is built on ls_
+  boost::scoped_ptr<tf::TransformListener> listener_; // NULL when given a transformer
+  const tf::Transformer& ls_;
+
+public:
+  FrameCache wrench_frames_;
+
+  // Force field plugins, only created if ~force_fields is set
+  boost::scoped_ptr<ForceFieldChain> force_fields_;
+  std::vector<char> force_fields_enabled_; // as of the last diagnostics report
+
+  // Low-latency force input read by the servo loop; replaces force_feedback
+  CommandSocket command_socket_;
+
+  // Records every servo tick to ~log_file; closed once the servo loop is gone
+  boost::scoped_ptr<FlightLogger> flight_log_;
+  unsigned long log_dropped_; // as of the last diagnostics report
+
+  // Latest command; written from the callback threads and the publisher
+  boost::mutex command_mutex_;
+  PhantomCommand command_;
+  unsigned long button_dropped_;
+
+  // Cumulative servo timing at the previous diagnostics report
+  HistogramSnapshot period_prev_, execution_prev_, overrun_prev_;
+
+  // Batch being filled by the publisher thread
+  ServoSampleBatchPtr batch_;
+  unsigned long batch_dropped_;
+
+  // Meshes are loaded and their hierarchy built on this thread, so neither
+  // the servo loop nor the ROS callbacks wait for it
+  boost::thread mesh_thread_;
+  boost::mutex mesh_mutex_;
+  boost::condition_variable mesh_condition_;
+  HapticMeshConstPtr mesh_request_; // latest unprocessed request
+  tf::Transform mesh_transform_; // request pose in sensable_origin
+  std::vector<const MeshModel *> mesh_retired_; // replaced, still in use by the servo loop
+
+  std::atomic<bool> running_;
+
+  PhantomROS();
+  // Looks transforms up in transformer instead of listening to /tf; nothing
+  // talks to the ROS master before init(), so benchmarks can use it as is
+  explicit PhantomROS(const tf::Transformer& transformer);
+  // The servo loop must not be running any more
+  ~PhantomROS();
+
+  // Topics and the public parameters live in node, settings in pnode
+  int init(PhantomState *s, const ros::NodeHandle& node, const ros::NodeHandle& pnode);
+
+  void wrench_callback(const geometry_msgs::WrenchStampedConstPtr& wrench);
+  void scene_callback(const HapticSceneConstPtr& scene);
+  void mesh_callback(const HapticMeshConstPtr& mesh);
+  void force_field_callback(const ForceFieldUpdateConstPtr& update);
+  void lock_gains_callback(const LockGainsUpdateConstPtr& update);
+  // Loads requested meshes until stop()
+  void mesh_loop();
+  void diagnostics_callback(const ros::TimerEvent&);
+  // Publishes the latest state
+  void publish_phantom_state();
+  // Publishes a given servo sample, stamped with its acquisition time
+  void publish_sample(const PhantomSample& sample);
+  // Moves queued servo samples into batches, publishes the full ones
+  void publish_batches();
+  // Publishes the button events queued by the servo loop
+  void publish_buttons();
+
+  // Publishes at publish_rate until stop() or ROS shutdown. Callbacks are
+  // serviced by whoever owns the node handles (spinner or nodelet manager).
+  void publish_loop();
+  void stop();
+
+private:
+  // Sets up and times the hot paths below without init() or a ROS master
+  friend class PhantomROSBenchmark;
+  // Runs init() and the callbacks against a local transformer
+  friend class PhantomROSTest;
+
+  // Stylus pose in link_0, meters
+  void sample_pose(const PhantomSample& sample, geometry_msgs::Pose& pose) const;
+
+  // Hands gains in SI units to the servo loop. Returns 0 on success.
+  int set_lock_gains(const LockGainsUpdate& update);
+
+  static void interval(HistogramSnapshot& h, HistogramSnapshot& prev);
+
+  template <typename T>
+  static void add_value(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, T value);
+
+  static void add_latency(diagnostic_msgs::DiagnosticStatus& status, const std::string& name,
+                          const HistogramSnapshot& h);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_PHANTOM_ROS_H
@@ -0,0 +1,171 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Device state shared between the servo callback and the ROS side.
+ */
+
+#ifndef SENSABLE_PHANTOM_PHANTOM_STATE_H
+#define SENSABLE_PHANTOM_PHANTOM_STATE_H
+
+#include <vector>
+
+#include "sensable_phantom/command_socket.h"
+#include "sensable_phantom/event_fd.h"
+#include "sensable_phantom/flight_log.h"
+#include "sensable_phantom/force_field.h"
+#include "sensable_phantom/haptic_mesh.h"
+#include "sensable_phantom/haptic_scene.h"
+#include "sensable_phantom/kalman_estimator.h"
+#include "sensable_phantom/lock_controller.h"
+#include "sensable_phantom/lockfree.h"
+#include "sensable_phantom/phantom_device.h"
+#include "sensable_phantom/realtime.h"
+#include "sensable_phantom/servo_stats.h"
+#include "sensable_phantom/velocity_filter.h"
+
+namespace sensable_phantom
+{
+
+// Coherent copy of the device state produced by the servo thread every tick
+struct PhantomSample
+{
+  unsigned long tick;
+  int64_t stamp_ns; // CLOCK_MONOTONIC time the device was read
+  double position[3];
+  double velocity[3]; // mm/s
+  double acceleration[3]; // zero unless the Kalman estimator is used
+  double rot[3];
+  double joints[3];
+  double transform[16]; // column-major, as reported by the device
+  float thetas[7];
+  float theta_velocities[7]; // rad/s
+  int buttons[2];
+  int error; // device error code of the tick, 0 if none
+};
+
+// A button press or release, as seen by the servo loop
+struct ButtonEvent
+{
+  int64_t stamp_ns; // CLOCK_MONOTONIC time the device was read
+  uint32_t sequence; // one per event, so lost events show up as a gap
+  int buttons[2]; // state after the change
+};
+
+// Commands produced by the ROS threads and consumed by the servo thread
+struct PhantomCommand
+{
+  double force[3];
+  double torque[3];
+};
+
+// Everything except the exchange buffers and stats is owned by the servo thread
+struct PhantomState
+{
+  PhantomState();
+
+  PhantomDevice *device;
+  double servo_rate; // nominal, Hz
+  // Differences are taken at the measured servo rate rather than the nominal
+  // one; set when the backend is paced by the device
+  bool measured_rate;
+
+  double position[3]; //3x1 vector of position
+  double velocity[3]; //3x1 vector of velocity, mm/s
+  double acceleration[3];
+  // position -> velocity (and acceleration), configured before scheduling
+  VelocityFilter velocity_filter;
+  KalmanEstimator kalman;
+  bool kalman_enabled; // use kalman instead of velocity_filter
+  double rot[3];
+  double joints[3];
+  double force[3]; //3 element double vector force[0], force[1], force[2]
+  double torque[3]; //3 element double vector torque[0], torque[1], torque[2]
+  bool gimbal_torque_enabled; // torque goes to the device about the gimbal axes
+
+  double hd_cur_transform[16]; // column-major
+
+  float thetas[7];
+  float theta_velocities[7];
+  // joints and gimbal angles -> their rates, configured like velocity_filter
+  VelocityFilter joint_filter;
+  VelocityFilter gimbal_filter;
+  int buttons[2];
+  // Toggled by pressing both buttons; set before scheduling for ~locked
+  bool lock;
+  LockController lock_controller;
+
+  unsigned long tick;
+  // Every publish_decimation ticks the sample is queued for the publisher and
+  // publish_event is signalled; 0 leaves the publisher polling the seqlock.
+  unsigned publish_decimation;
+  unsigned publish_countdown;
+
+  Seqlock<PhantomSample> sample; // servo -> ROS
+  SpscRing<PhantomSample, 64> publish_queue; // servo -> publisher thread
+  EventFd publish_event;
+
+  // Every sample goes here for the batched stream when batch_enabled is set
+  bool batch_enabled;
+  SpscRing<PhantomSample, 1024> batch_queue; // servo -> publisher thread
+  std::atomic<unsigned long> batch_dropped;
+  // Every button edge, so presses shorter than a publish period are kept
+  SpscRing<ButtonEvent, 256> button_queue; // servo -> publisher thread
+  uint32_t button_sequence;
+  std::atomic<unsigned long> button_dropped;
+  // Every tick is recorded here when set; drained by the FlightLogger
+  FlightLogQueue *log_queue;
+  std::atomic<unsigned long> log_dropped;
+  TripleBuffer<PhantomCommand> command; // ROS -> servo
+  TripleBuffer<PrimitiveScene> scene; // ROS -> servo, rendered every tick
+  TripleBuffer<LockGains> lock_gains; // ROS -> servo
+
+  // Mesh rendered every tick, swapped in by the ROS side. mesh_hazard is the
+  // model the servo loop may be using; a replaced model is freed only once
+  // the servo loop has moved off it.
+  std::atomic<const MeshModel *> mesh;
+  std::atomic<const MeshModel *> mesh_hazard;
+  MeshProxy mesh_proxy; // servo thread only
+
+  ForceFieldChain *force_fields; // plugins run every tick; NULL if there are none
+
+  // Optional UDP command path. When set, it owns force and torque: the newest
+  // packet is applied while younger than command_timeout_ns, zero otherwise.
+  CommandSocket *command_socket;
+  CommandPacket remote_command;
+  int64_t command_timeout_ns;
+  double command_damping; // damping_k in N/(mm/s), applied in the loop to remote forces
+  double command_max_force; // N, remote forces are clamped to this magnitude
+  std::atomic<unsigned long> remote_received; // packets applied
+  std::atomic<unsigned long> remote_stale; // ticks with a zeroed command
+  ServoStats stats; // written by servo, read by ROS
+};
+
+// Servo loop; schedule it with &PhantomState as user data
+bool phantom_state_callback(void *pUserData);
+
+// Several devices serviced from a single scheduler callback, so they are all
+// sampled in the same tick and the scheduler runs one callback instead of N
+struct PhantomGroup
+{
+  PhantomGroup() : servo_setup(0)
+  {
+  }
+
+  std::vector<PhantomState *> states;
+  std::vector<char> active; // servo thread only
+
+  // Applied by the servo thread to itself on the first tick; the result is
+  // 0 until then, 1 on success or -errno
+  RealtimeConfig realtime;
+  std::atomic<int> servo_setup;
+};
+
+// Servo loop for a group; schedule it with &PhantomGroup as user data
+bool phantom_group_callback(void *pUserData);
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_PHANTOM_STATE_H
@@ -0,0 +1,63 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Real-time process setup: locked memory, prefaulted stacks, SCHED_FIFO
+ * priorities and CPU affinity for the driver threads. All of it is optional
+ * and off unless ~realtime is set.
+ */
+
+#ifndef SENSABLE_PHANTOM_REALTIME_H
+#define SENSABLE_PHANTOM_REALTIME_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+#include <string>
+
+namespace ros
+{
+class NodeHandle;
+}
+
+namespace sensable_phantom
+{
+
+// Priorities are SCHED_FIFO levels, 0 leaves the scheduling policy alone;
+// CPUs are core numbers, -1 leaves the affinity alone
+struct RealtimeConfig
+{
+  RealtimeConfig();
+
+  // Reads ~realtime and, if set, the ~realtime_* settings. Returns 0 on success.
+  int load(const ros::NodeHandle& pnode);
+
+  bool enabled;
+  bool lock_memory;
+  size_t stack_prefault; // bytes touched on every driver thread's stack
+  int servo_priority;
+  int servo_cpu;
+  int publish_priority;
+  int publish_cpu;
+  int callback_priority; // ROS callback threads, e.g. force feedback
+  int callback_cpu;
+};
+
+// mlockall() and no heap trimming or mmap'ed chunks, so pages once touched
+// stay resident. Returns 0 or an errno value.
+int lock_memory();
+
+// Touches bytes of the calling thread's stack so it is resident
+void prefault_stack(size_t bytes);
+
+// Applies priority and cpu to thread. Returns 0 or an errno value.
+int set_thread_realtime(pthread_t thread, int priority, int cpu);
+
+// "SCHED_FIFO 80 on CPU 2" and the like, for the startup report
+std::string describe_realtime(int priority, int cpu);
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_REALTIME_H
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Replayed PHANToM. Every tick the device reports the next sample of a
+ * recorded trajectory, a flight log (see flight_log.h) or a CSV file, so the
+ * servo loop and the publishers run exactly as they did on the hardware. The
+ * trajectory is paced at its recorded rate or played back to back. The
+ * output written by the servo loop is kept for every tick and saved next to
+ * the recorded one, so the two can be compared.
+ */
+
+#ifndef SENSABLE_PHANTOM_REPLAY_BACKEND_H
+#define SENSABLE_PHANTOM_REPLAY_BACKEND_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "sensable_phantom/flight_log.h"
+#include "sensable_phantom/phantom_device.h"
+#include "sensable_phantom/servo_scheduler.h"
+
+namespace sensable_phantom
+{
+
+struct ReplayTrajectory
+{
+  std::string path;
+  std::string model;
+  double rate; // recorded servo rate, Hz
+  std::vector<FlightLogRecord> records;
+};
+
+// Loads a flight log or, for a .csv extension, a CSV file with a header row.
+// CSV columns are matched by name: x, y, z (mm) are required; joint0..2 and
+// gimbal0..2 (rad), buttons, fx, fy, fz (N) and tx, ty, tz (Nm) default to
+// zero. The transform is rebuilt from position and gimbal angles. CSV files
+// carry no rate; csv_rate is used. Returns 0 on success.
+int load_trajectory(const std::string& path, double csv_rate, ReplayTrajectory& trajectory);
+
+struct ReplayConfig
+{
+  ReplayConfig();
+
+  std::vector<std::string> files; // one per device, in the order they are opened
+  double csv_rate; // rate of CSV trajectories, Hz
+  bool realtime; // pace at the recorded rate; otherwise as fast as possible
+  bool loop; // start over at the end instead of stopping
+  bool shutdown; // request ROS shutdown once every device reached the end
+  std::string output_file; // CSV of commanded and recorded output per tick; empty disables
+};
+
+class ReplayBackend;
+
+class ReplayDevice : public PhantomDevice
+{
+public:
+  // Takes the records over from trajectory
+  ReplayDevice(ReplayTrajectory& trajectory, ReplayBackend& backend, bool loop);
+
+  std::string model() const
+  {
+    return trajectory_.model;
+  }
+
+  void calibrate()
+  {
+  }
+
+  void begin_frame()
+  {
+  }
+
+  void read(DeviceInput& in);
+  void write(const DeviceOutput& out);
+  bool end_frame();
+
+  const ReplayTrajectory& trajectory() const
+  {
+    return trajectory_;
+  }
+
+  // Output of the first pass, one per record; valid up to captured()
+  const std::vector<DeviceOutput>& output() const
+  {
+    return output_;
+  }
+
+  size_t captured() const
+  {
+    return captured_.load(std::memory_order_acquire);
+  }
+
+private:
+  ReplayTrajectory trajectory_;
+  std::vector<DeviceOutput> output_; // preallocated, the servo loop only fills it
+  std::atomic<size_t> captured_;
+  size_t tick_;
+  bool first_pass_;
+  ReplayBackend& backend_;
+  bool loop_;
+};
+
+class ReplayBackend : public PhantomBackend
+{
+public:
+  explicit ReplayBackend(const ReplayConfig& config);
+  // Stops and writes the output file
+  ~ReplayBackend();
+
+  PhantomDevice* open(const std::string& name);
+  bool start();
+  void stop();
+  void schedule(ServoCallback callback, void *user_data);
+
+  // The recorded rate, also when playing back faster
+  double update_rate() const
+  {
+    return rate_;
+  }
+
+  // Played back faster, ticks say nothing about the recorded rate
+  bool paced() const
+  {
+    return config_.realtime;
+  }
+
+  // Servo thread, once per device that reached the end of its trajectory
+  void finished();
+
+private:
+  // Returns 0 on success
+  int save_output() const;
+
+  ReplayConfig config_;
+  double rate_;
+  ServoScheduler scheduler_;
+  std::vector<ReplayDevice *> devices_;
+  std::atomic<int> finished_; // devices at the end
+  bool started_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_REPLAY_BACKEND_H
@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Software replacement for the OpenHaptics servo scheduler. A single thread
+ * runs all scheduled callbacks at a fixed rate on absolute CLOCK_MONOTONIC
+ * deadlines, so the period does not drift with callback execution time.
+ */
+
+#ifndef SENSABLE_PHANTOM_SERVO_SCHEDULER_H
+#define SENSABLE_PHANTOM_SERVO_SCHEDULER_H
+
+#include <atomic>
+#include <pthread.h>
+
+#include "sensable_phantom/phantom_device.h"
+
+namespace sensable_phantom
+{
+
+class ServoScheduler
+{
+public:
+  static const int MAX_CALLBACKS = 16;
+
+  ServoScheduler();
+  ~ServoScheduler();
+
+  // rate <= 0 runs the callbacks back to back, as fast as possible
+  bool start(double rate);
+  void stop();
+
+  // May be called before or after start(), from any single thread.
+  bool schedule(ServoCallback callback, void *user_data);
+
+  double rate() const
+  {
+    return rate_;
+  }
+
+  bool running() const
+  {
+    return running_.load(std::memory_order_acquire);
+  }
+
+private:
+  struct Entry
+  {
+    ServoCallback callback;
+    void *user_data;
+    bool active; // servo thread only
+  };
+
+  static void *run(void *ptr);
+  void loop();
+
+  double rate_;
+  pthread_t thread_;
+  bool started_;
+  std::atomic<bool> running_;
+  Entry entries_[MAX_CALLBACKS];
+  std::atomic<int> count_;
+
+  ServoScheduler(const ServoScheduler&);
+  ServoScheduler& operator=(const ServoScheduler&);
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_SERVO_SCHEDULER_H
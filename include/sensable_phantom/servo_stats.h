@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Servo loop timing instrumentation. The servo thread timestamps every tick
+ * with CLOCK_MONOTONIC and records period, execution time and overruns into
+ * HDR-style log-linear histograms. Recording is a couple of relaxed atomic
+ * stores; readers take snapshots and diff them to get per-interval figures.
+ */
+
+#ifndef SENSABLE_PHANTOM_SERVO_STATS_H
+#define SENSABLE_PHANTOM_SERVO_STATS_H
+
+#include <atomic>
+#include <stdint.h>
+#include <time.h>
+
+namespace sensable_phantom
+{
+
+inline int64_t monotonic_ns()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+// Values below 2 * SUB_BUCKETS ns are exact, above that every power of two
+// is split into SUB_BUCKETS buckets (~3% resolution) up to ~17 s.
+struct HistogramSnapshot
+{
+  static const int SUB_BUCKET_BITS = 5;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int MAX_EXPONENT = 29;
+  static const int BUCKETS = 2 * SUB_BUCKETS + MAX_EXPONENT * SUB_BUCKETS;
+
+  uint64_t counts[BUCKETS];
+
+  static int index(uint64_t value);
+  // Largest value that falls into bucket i
+  static uint64_t highest_equivalent(int i);
+
+  uint64_t total() const;
+  // q in [0, 1]; returns 0 for an empty histogram
+  uint64_t percentile(double q) const;
+  uint64_t max() const;
+  double mean() const;
+
+  // this -= older; turns two cumulative snapshots into an interval
+  void subtract(const HistogramSnapshot& older);
+};
+
+// Single writer histogram
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  void record(uint64_t value_ns)
+  {
+    std::atomic<uint64_t>& c = counts_[HistogramSnapshot::index(value_ns)];
+    c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+  }
+
+  void snapshot(HistogramSnapshot& s) const;
+
+private:
+  std::atomic<uint64_t> counts_[HistogramSnapshot::BUCKETS];
+
+  LatencyHistogram(const LatencyHistogram&);
+  LatencyHistogram& operator=(const LatencyHistogram&);
+};
+
+class ServoStats
+{
+public:
+  ServoStats();
+
+  // Nominal servo rate. A tick whose period exceeds the nominal one by more
+  // than tolerance (fraction of the period) counts as an overrun.
+  void configure(double rate, double tolerance);
+
+  // Servo thread only, at the very start and end of the callback
+  void tick_begin()
+  {
+    int64_t now = monotonic_ns();
+    if (last_begin_ns_ != 0)
+    {
+      int64_t period = now - last_begin_ns_;
+      period_.record(period);
+      if (period > overrun_ns_)
+        overrun_.record(period - period_ns_);
+      // A stall counts as two periods at most, so one does not throw the mean off
+      double sample = period < 2 * period_ns_ ? period : 2 * period_ns_;
+      mean_period_ns_ += smoothing_ * (sample - mean_period_ns_);
+    }
+    last_begin_ns_ = now;
+  }
+
+  void tick_end()
+  {
+    execution_.record(monotonic_ns() - last_begin_ns_);
+  }
+
+  int64_t period_ns() const
+  {
+    return period_ns_;
+  }
+
+  // Servo thread only. Tick rate averaged over about a second, Hz; the
+  // nominal rate until ticks come in.
+  double measured_rate() const
+  {
+    return 1e9 / mean_period_ns_;
+  }
+
+  // Time between consecutive tick_begin() calls
+  const LatencyHistogram& period() const
+  {
+    return period_;
+  }
+  // Time between tick_begin() and tick_end()
+  const LatencyHistogram& execution() const
+  {
+    return execution_;
+  }
+  // Lateness (period minus nominal period) of overrun ticks
+  const LatencyHistogram& overrun() const
+  {
+    return overrun_;
+  }
+
+private:
+  int64_t period_ns_;
+  int64_t overrun_ns_;
+  int64_t last_begin_ns_; // servo thread only
+  double mean_period_ns_; // servo thread only
+  double smoothing_; // per tick
+
+  LatencyHistogram period_;
+  LatencyHistogram execution_;
+  LatencyHistogram overrun_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_SERVO_STATS_H
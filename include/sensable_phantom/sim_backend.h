@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Simulated PHANToM. The stylus follows a Lissajous trajectory, as if held by
+ * an operator, and is displaced from it by the commanded forces through a
+ * mass-spring-damper, so force laws running in the servo loop have an effect.
+ */
+
+#ifndef SENSABLE_PHANTOM_SIM_BACKEND_H
+#define SENSABLE_PHANTOM_SIM_BACKEND_H
+
+#include <string>
+#include <vector>
+
+#include "sensable_phantom/phantom_device.h"
+#include "sensable_phantom/servo_scheduler.h"
+
+namespace sensable_phantom
+{
+
+struct SimConfig
+{
+  SimConfig();
+
+  std::string model;
+  double rate;               // servo rate, Hz
+  double amplitude[3];       // trajectory amplitude, mm
+  double frequency;          // trajectory base frequency, Hz
+  double gimbal_amplitude;   // rad
+  double mass;               // stylus mass, kg
+  double stiffness;          // operator hand stiffness, N/mm
+  double damping;            // operator hand damping, N/(mm/s)
+  double max_force;          // output saturation, N
+  double button_period;      // each button is pressed once per period, s (0 disables)
+};
+
+class SimDevice : public PhantomDevice
+{
+public:
+  SimDevice(const SimConfig& config, int index);
+
+  std::string model() const
+  {
+    return config_.model;
+  }
+
+  void calibrate()
+  {
+  }
+
+  void begin_frame();
+  void read(DeviceInput& in);
+  void write(const DeviceOutput& out);
+
+  bool end_frame()
+  {
+    tick_++;
+    return true;
+  }
+
+  // Last output written by the servo loop
+  const DeviceOutput& output() const
+  {
+    return output_;
+  }
+
+private:
+  SimConfig config_;
+  double dt_;
+  double phase_;
+  unsigned long tick_;
+  double offset_[3];     // displacement from the trajectory caused by forces, mm
+  double offset_vel_[3]; // mm/s
+  DeviceOutput output_;
+};
+
+class SimBackend : public PhantomBackend
+{
+public:
+  explicit SimBackend(const SimConfig& config);
+  ~SimBackend();
+
+  PhantomDevice* open(const std::string& name);
+  bool start();
+  void stop();
+  void schedule(ServoCallback callback, void *user_data);
+
+  double update_rate() const
+  {
+    return config_.rate;
+  }
+
+private:
+  SimConfig config_;
+  ServoScheduler scheduler_;
+  std::vector<SimDevice *> devices_;
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_SIM_BACKEND_H
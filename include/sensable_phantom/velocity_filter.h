@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Stylus velocity estimator: 2nd order backward difference followed by a
+ * Butterworth low-pass of configurable order and cutoff. Coefficients are
+ * computed once from the actual servo rate (bilinear transform with
+ * prewarping, as cascaded second order sections), step() only does
+ * arithmetic on fixed-size members.
+ */
+
+#ifndef SENSABLE_PHANTOM_VELOCITY_FILTER_H
+#define SENSABLE_PHANTOM_VELOCITY_FILTER_H
+
+namespace sensable_phantom
+{
+
+class VelocityFilter
+{
+public:
+  static const int MAX_ORDER = 8;
+
+  // 3rd order, 20 Hz at 1 kHz, like the original hard-coded filter
+  VelocityFilter();
+
+  // cutoff and rate in Hz. Returns 0 on success, -1 if the order is not in
+  // [1, MAX_ORDER] or the cutoff is not below Nyquist. Resets the history.
+  int configure(int order, double cutoff, double rate);
+
+  // Next step() starts from rest at the position it is given
+  void reset();
+
+  // Rate the backward difference is taken at, Hz, e.g. the measured servo
+  // rate when it is off the nominal one. The low-pass keeps the
+  // coefficients of configure().
+  void set_sample_rate(double rate)
+  {
+    if (rate > 0.0)
+      rate_ = rate;
+  }
+
+  // One servo tick. velocity is in position units per second.
+  void step(const double position[3], double velocity[3]);
+
+  int order() const
+  {
+    return order_;
+  }
+
+  double cutoff() const
+  {
+    return cutoff_;
+  }
+
+private:
+  static const int MAX_SECTIONS = (MAX_ORDER + 1) / 2;
+
+  // Normalized (a0 = 1) biquad; first order sections have b2 = a2 = 0
+  struct Section
+  {
+    double b0, b1, b2, a1, a2;
+  };
+
+  int order_;
+  double cutoff_;
+  double rate_;
+  int n_sections_;
+  Section sections_[MAX_SECTIONS];
+
+  bool primed_;
+  double pos_hist1_[3];
+  double pos_hist2_[3];
+  double z_[MAX_SECTIONS][3][2]; // transposed direct form II state
+};
+
+} // namespace sensable_phantom
+
+#endif // SENSABLE_PHANTOM_VELOCITY_FILTER_H
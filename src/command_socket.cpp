@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <cmath>
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/command_socket.h"
+
+namespace sensable_phantom
+{
+
+// Kernel receive buffer, bytes. Small, so a flood queues only a few packets
+// and a fresh one is never stuck behind seconds of backlog.
+static const int RECEIVE_BUFFER = 4096;
+
+bool parse_command_packet(const void *data, size_t size, CommandPacket& packet)
+{
+  if (size != sizeof(CommandPacket))
+    return false;
+  CommandPacket buf;
+  memcpy(&buf, data, sizeof(buf));
+  if (buf.magic != CommandPacket::MAGIC)
+    return false;
+  for (int i = 0; i < 3; i++)
+  {
+    if (!std::isfinite(buf.force[i]) || !std::isfinite(buf.torque[i]))
+      return false;
+  }
+  packet = buf;
+  return true;
+}
+
+CommandSocket::CommandSocket() : fd_(-1), tolerance_ns_(0), last_stamp_ns_(0), rejected_(0)
+{
+}
+
+CommandSocket::~CommandSocket()
+{
+  close();
+}
+
+int CommandSocket::open(const std::string& address, int port, int64_t tolerance_ns)
+{
+  close();
+  tolerance_ns_ = tolerance_ns;
+  last_stamp_ns_ = 0;
+
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (inet_pton(AF_INET, address.c_str(), &addr.sin_addr) != 1)
+  {
+    ROS_ERROR("Invalid command address '%s'", address.c_str());
+    return -1;
+  }
+
+  fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd_ < 0)
+  {
+    ROS_ERROR("Failed to create command socket: %s", strerror(errno));
+    return -1;
+  }
+
+  int size = RECEIVE_BUFFER;
+  if (setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0)
+    ROS_WARN("Failed to shrink the command socket buffer: %s", strerror(errno));
+
+  if (bind(fd_, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+  {
+    ROS_ERROR("Failed to bind command socket to %s:%d: %s", address.c_str(), port, strerror(errno));
+    close();
+    return -1;
+  }
+
+  return 0;
+}
+
+void CommandSocket::close()
+{
+  if (fd_ >= 0)
+    ::close(fd_);
+  fd_ = -1;
+}
+
+bool CommandSocket::receive(CommandPacket& packet)
+{
+  bool updated = false;
+  int64_t now_ns = realtime_ns();
+  // The local clock was stepped back; stamps from before the step would
+  // otherwise shut every new packet out
+  if (last_stamp_ns_ > now_ns + tolerance_ns_)
+    last_stamp_ns_ = 0;
+
+  CommandPacket buf;
+  for (int i = 0; i < MAX_PACKETS_PER_RECEIVE; i++)
+  {
+    char data[sizeof(CommandPacket) + 1];
+    ssize_t n = recv(fd_, data, sizeof(data), MSG_DONTWAIT);
+    if (n < 0)
+      break; // EAGAIN: drained
+
+    // Reordered datagrams are older than what we have, drop them. Ordering
+    // by stamp rather than seq survives a sender restart. A stamp from the
+    // future is not trusted, it would hold off the packets that follow.
+    if (!parse_command_packet(data, n, buf) || buf.stamp_ns < last_stamp_ns_ || buf.stamp_ns > now_ns + tolerance_ns_)
+    {
+      rejected_.store(rejected_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      continue;
+    }
+
+    last_stamp_ns_ = buf.stamp_ns;
+    packet = buf;
+    updated = true;
+  }
+  return updated;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/command_socket.h"
+#include "sensable_phantom/flight_log.h"
+#include "sensable_phantom/servo_stats.h"
+
+namespace sensable_phantom
+{
+
+const char FLIGHT_LOG_MAGIC[8] = {'P', 'H', 'N', 'T', 'M', 'L', 'O', 'G'};
+
+// Bytes of the file mapped at a time, about a minute at 1 kHz
+static const size_t WINDOW_SIZE = 16 << 20;
+
+FlightLogger::FlightLogger() :
+    fd_(-1), header_(NULL), window_(NULL), window_offset_(0), capacity_(0), grow_step_(0), running_(false), written_(0),
+    failed_(false)
+{
+}
+
+FlightLogger::~FlightLogger()
+{
+  stop();
+}
+
+static uint64_t file_size(uint64_t records)
+{
+  return sizeof(FlightLogHeader) + records * sizeof(FlightLogRecord);
+}
+
+// Reserves the blocks up front, so the drain thread does not hit a full disk
+// halfway through a session. Filesystems without fallocate get a sparse file.
+static int preallocate(int fd, uint64_t size)
+{
+  int ret = posix_fallocate(fd, 0, size);
+  if (ret == EOPNOTSUPP || ret == EINVAL)
+    ret = ftruncate(fd, size) ? errno : 0;
+  return ret;
+}
+
+int FlightLogger::open(const std::string& path, double duration, double servo_rate, const std::string& name,
+                       const std::string& model)
+{
+  if (duration <= 0.0 || servo_rate <= 0.0)
+  {
+    ROS_ERROR("Flight log duration and servo rate must be positive");
+    return -1;
+  }
+
+  // One minute of records at a time once the preallocated part is full
+  grow_step_ = (uint64_t)(60.0 * servo_rate);
+  capacity_ = std::max((uint64_t)(duration * servo_rate), grow_step_);
+  path_ = path;
+
+  fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd_ < 0)
+  {
+    ROS_ERROR("Cannot create flight log %s: %s", path.c_str(), strerror(errno));
+    return -1;
+  }
+
+  int ret = preallocate(fd_, file_size(capacity_));
+  if (ret)
+  {
+    ROS_ERROR("Cannot allocate %llu MB for flight log %s: %s", (unsigned long long)(file_size(capacity_) >> 20),
+              path.c_str(), strerror(ret));
+    close();
+    return -1;
+  }
+
+  void *header = mmap(NULL, sizeof(FlightLogHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (header == MAP_FAILED)
+  {
+    ROS_ERROR("Cannot map flight log %s: %s", path.c_str(), strerror(errno));
+    close();
+    return -1;
+  }
+  header_ = static_cast<FlightLogHeader *>(header);
+
+  memset(header_, 0, sizeof(*header_));
+  memcpy(header_->magic, FLIGHT_LOG_MAGIC, sizeof(header_->magic));
+  header_->version = FlightLogHeader::VERSION;
+  header_->record_size = sizeof(FlightLogRecord);
+  header_->count = 0;
+  header_->servo_rate = servo_rate;
+  header_->start_realtime_ns = realtime_ns();
+  header_->start_monotonic_ns = monotonic_ns();
+  strncpy(header_->name, name.c_str(), sizeof(header_->name) - 1);
+  strncpy(header_->model, model.c_str(), sizeof(header_->model) - 1);
+
+  if (map_window(file_size(0)))
+  {
+    close();
+    return -1;
+  }
+
+  written_ = 0;
+  failed_ = false;
+  ROS_INFO("Flight log %s: %llu MB preallocated for %.0f s", path.c_str(),
+           (unsigned long long)(file_size(capacity_) >> 20), duration);
+  return 0;
+}
+
+void FlightLogger::start()
+{
+  if (!header_ || running_)
+    return;
+  running_ = true;
+  thread_ = boost::thread(&FlightLogger::loop, this);
+}
+
+void FlightLogger::stop()
+{
+  running_ = false;
+  if (thread_.joinable())
+    thread_.join();
+  if (header_)
+  {
+    drain();
+    ROS_INFO("Flight log %s: %llu records", path_.c_str(), (unsigned long long)written());
+  }
+  close();
+}
+
+void FlightLogger::loop()
+{
+  // The ring holds seconds of data, a lazy poll is plenty
+  while (running_)
+  {
+    if (drain() == 0)
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(10));
+  }
+}
+
+size_t FlightLogger::drain()
+{
+  uint64_t count = header_->count;
+  size_t n = 0;
+  FlightLogRecord record;
+  while (queue_.pop(record))
+  {
+    // Once the file cannot take more, keep emptying the ring so the servo
+    // side does not count drops; those records are lost either way
+    if (failed_)
+      continue;
+    if (count == capacity_ && grow())
+      continue;
+
+    uint64_t offset = file_size(count);
+    if (offset + sizeof(record) > window_offset_ + WINDOW_SIZE && map_window(offset))
+      continue;
+    memcpy(window_ + (offset - window_offset_), &record, sizeof(record));
+    count++;
+    n++;
+  }
+
+  if (n)
+  {
+    header_->count = count;
+    written_.store(count, std::memory_order_relaxed);
+  }
+  return n;
+}
+
+int FlightLogger::grow()
+{
+  uint64_t capacity = capacity_ + grow_step_;
+  int ret = preallocate(fd_, file_size(capacity));
+  if (ret)
+  {
+    ROS_ERROR("Flight log %s is full at %llu records and cannot grow: %s", path_.c_str(),
+              (unsigned long long)capacity_, strerror(ret));
+    failed_ = true;
+    return -1;
+  }
+  capacity_ = capacity;
+  return 0;
+}
+
+int FlightLogger::map_window(uint64_t offset)
+{
+  if (window_)
+    munmap(window_, WINDOW_SIZE);
+  window_ = NULL;
+
+  window_offset_ = offset & ~(uint64_t)(sysconf(_SC_PAGESIZE) - 1);
+  void *window = mmap(NULL, WINDOW_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, window_offset_);
+  if (window == MAP_FAILED)
+  {
+    ROS_ERROR("Cannot map flight log %s: %s", path_.c_str(), strerror(errno));
+    failed_ = true;
+    return -1;
+  }
+  window_ = static_cast<char *>(window);
+  madvise(window_, WINDOW_SIZE, MADV_SEQUENTIAL);
+  return 0;
+}
+
+void FlightLogger::close()
+{
+  if (window_)
+  {
+    munmap(window_, WINDOW_SIZE);
+    window_ = NULL;
+  }
+  if (header_)
+  {
+    uint64_t size = file_size(header_->count);
+    munmap(header_, sizeof(FlightLogHeader));
+    header_ = NULL;
+    // Drop the unused preallocated tail
+    if (ftruncate(fd_, size))
+      ROS_WARN("Cannot trim flight log %s: %s", path_.c_str(), strerror(errno));
+  }
+  if (fd_ >= 0)
+  {
+    ::close(fd_);
+    fd_ = -1;
+  }
+}
+
+int read_flight_log(const std::string& path, FlightLogHeader& header, std::vector<FlightLogRecord>& records)
+{
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    ROS_ERROR("Cannot open flight log %s", path.c_str());
+    return -1;
+  }
+
+  if (!file.read((char *)&header, sizeof(header)) || memcmp(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic)) != 0)
+  {
+    ROS_ERROR("%s is not a flight log", path.c_str());
+    return -1;
+  }
+  if (header.version != FlightLogHeader::VERSION || header.record_size != sizeof(FlightLogRecord))
+  {
+    ROS_ERROR("Flight log %s has version %u with %u byte records, expected version %u with %zu", path.c_str(),
+              header.version, header.record_size, FlightLogHeader::VERSION, sizeof(FlightLogRecord));
+    return -1;
+  }
+
+  // The count comes from the file; never allocate more records than it holds
+  file.seekg(0, std::ios::end);
+  uint64_t available = ((uint64_t)file.tellg() - sizeof(header)) / sizeof(FlightLogRecord);
+  file.seekg(sizeof(header), std::ios::beg);
+  uint64_t count = header.count < available ? header.count : available;
+
+  records.resize(count);
+  if (count && !file.read((char *)&records[0], count * sizeof(FlightLogRecord)))
+    records.resize(file.gcount() / sizeof(FlightLogRecord));
+  if (records.size() < header.count)
+  {
+    // Cut short or damaged; keep the records that are there
+    ROS_WARN("Flight log %s is truncated, %zu of %llu records read", path.c_str(), records.size(),
+             (unsigned long long)header.count);
+  }
+  return 0;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <string.h>
+
+#include "sensable_phantom/force_field.h"
+
+namespace sensable_phantom
+{
+
+int ForceFieldParameters::add(const std::string& name, double value)
+{
+  if (count >= MAX || name.size() >= (size_t)NAME_LENGTH)
+    return -1;
+  strncpy(names[count], name.c_str(), NAME_LENGTH);
+  values[count] = value;
+  return count++;
+}
+
+int ForceFieldParameters::find(const std::string& name) const
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (name == names[i])
+      return i;
+  }
+  return -1;
+}
+
+ForceFieldChain::ForceFieldChain() : loader_("sensable_phantom", "sensable_phantom::ForceField")
+{
+}
+
+ForceFieldChain::~ForceFieldChain()
+{
+  // Plugins go before the loader that owns their libraries
+  for (size_t i = 0; i < fields_.size(); i++)
+    delete fields_[i];
+}
+
+int ForceFieldChain::load(const ros::NodeHandle& pnode)
+{
+  std::vector<std::string> names;
+  pnode.getParam(std::string("force_fields"), names);
+
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    ros::NodeHandle field_pnode(pnode, names[i]);
+    std::string type;
+    if (!field_pnode.getParam(std::string("type"), type))
+    {
+      ROS_FATAL("Force field %s has no type", names[i].c_str());
+      return -1;
+    }
+
+    Field *field = new Field;
+    fields_.push_back(field);
+    field->name = names[i];
+    field->consecutive = 0;
+    field->overruns = 0;
+    field->enabled = true;
+
+    // Execution time allowed per tick, s
+    double budget;
+    field_pnode.param(std::string("budget"), budget, 50e-6);
+    field->budget_ns = (int64_t)(budget * 1e9);
+    // A single late tick may be preemption; this many in a row is the plugin
+    field_pnode.param(std::string("overrun_limit"), field->overrun_limit, 3);
+
+    try
+    {
+      field->plugin = loader_.createInstance(type);
+    }
+    catch(pluginlib::PluginlibException& ex)
+    {
+      ROS_FATAL("Failed to load force field %s of type %s: %s", names[i].c_str(), type.c_str(), ex.what());
+      return -1;
+    }
+
+    memset(&field->parameters, 0, sizeof(field->parameters));
+    if (field->plugin->initialize(field_pnode, field->parameters))
+    {
+      ROS_FATAL("Failed to initialize force field %s", names[i].c_str());
+      return -1;
+    }
+    // The servo loop has not run yet, so the plugin can be configured directly
+    field->plugin->configure(field->parameters);
+
+    ROS_INFO("Force field %s: %s, budget %.0f us", names[i].c_str(), type.c_str(), budget * 1e6);
+  }
+  return 0;
+}
+
+bool ForceFieldChain::set_parameters(const std::string& name, const std::vector<std::string>& names,
+                                     const std::vector<double>& values)
+{
+  if (names.size() != values.size())
+  {
+    ROS_ERROR("Force field %s: %zu parameter names but %zu values", name.c_str(), names.size(), values.size());
+    return false;
+  }
+
+  for (size_t i = 0; i < fields_.size(); i++)
+  {
+    Field *field = fields_[i];
+    if (field->name != name)
+      continue;
+
+    boost::mutex::scoped_lock lock(field->parameters_mutex);
+    ForceFieldParameters parameters = field->parameters;
+    for (size_t k = 0; k < names.size(); k++)
+    {
+      int index = parameters.find(names[k]);
+      if (index < 0)
+      {
+        ROS_ERROR("Force field %s has no parameter %s", name.c_str(), names[k].c_str());
+        return false;
+      }
+      parameters.values[index] = values[k];
+    }
+    field->parameters = parameters;
+    field->mailbox.write(parameters);
+    return true;
+  }
+
+  ROS_ERROR("No force field named %s", name.c_str());
+  return false;
+}
+
+void ForceFieldChain::update(const ForceFieldInput& in, double force[3], double torque[3])
+{
+  for (size_t i = 0; i < fields_.size(); i++)
+  {
+    Field *field = fields_[i];
+    if (!field->enabled.load(std::memory_order_relaxed))
+      continue;
+
+    if (field->mailbox.update())
+      field->plugin->configure(field->mailbox.front());
+
+    // The plugin writes into scratch, so a disabled plugin's last output is dropped
+    double f[3] = {0.0, 0.0, 0.0};
+    double t[3] = {0.0, 0.0, 0.0};
+    int64_t start = monotonic_ns();
+    field->plugin->update(in, f, t);
+    int64_t elapsed = monotonic_ns() - start;
+    field->execution.record(elapsed);
+
+    if (elapsed > field->budget_ns)
+    {
+      field->overruns.store(field->overruns.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      if (++field->consecutive >= field->overrun_limit)
+      {
+        field->enabled.store(false, std::memory_order_relaxed);
+        continue;
+      }
+    }
+    else
+      field->consecutive = 0;
+
+    for (int k = 0; k < 3; k++)
+    {
+      force[k] += f[k];
+      torque[k] += t[k];
+    }
+  }
+}
+
+void ForceFieldChain::status(std::vector<Status>& status) const
+{
+  status.resize(fields_.size());
+  for (size_t i = 0; i < fields_.size(); i++)
+  {
+    const Field *field = fields_[i];
+    status[i].name = field->name;
+    status[i].enabled = field->enabled.load(std::memory_order_relaxed);
+    status[i].budget_ns = field->budget_ns;
+    status[i].overruns = field->overruns.load(std::memory_order_relaxed);
+    field->execution.snapshot(status[i].execution);
+  }
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Force fields shipped with the driver. They double as examples for
+ * site-specific plugins.
+ */
+
+#include <math.h>
+
+#include <pluginlib/class_list_macros.h>
+
+#include "sensable_phantom/force_field.h"
+
+namespace sensable_phantom
+{
+
+// Scales force down to max_force (N) if it is larger; max_force <= 0 disables the limit
+static void saturate(double force[3], double max_force)
+{
+  double norm = sqrt(force[0] * force[0] + force[1] * force[1] + force[2] * force[2]);
+  if (max_force <= 0.0 || norm <= max_force)
+    return;
+  for (int i = 0; i < 3; i++)
+    force[i] *= max_force / norm;
+}
+
+/*
+ * Spring-damper towards an anchor point. Parameters, all tunable at run time:
+ * stiffness (N/m), damping (Ns/m), anchor_x/y/z (m, sensable_origin),
+ * max_force (N).
+ */
+class SpringField : public ForceField
+{
+public:
+  int initialize(const ros::NodeHandle& pnode, ForceFieldParameters& parameters)
+  {
+    double value;
+    pnode.param(std::string("stiffness"), value, 40.0);
+    stiffness_ = parameters.add("stiffness", value);
+    pnode.param(std::string("damping"), value, 1.0);
+    damping_ = parameters.add("damping", value);
+    pnode.param(std::string("anchor_x"), value, 0.0);
+    anchor_ = parameters.add("anchor_x", value);
+    pnode.param(std::string("anchor_y"), value, 0.0);
+    parameters.add("anchor_y", value);
+    pnode.param(std::string("anchor_z"), value, 0.0);
+    parameters.add("anchor_z", value);
+    pnode.param(std::string("max_force"), value, 3.0);
+    max_force_ = parameters.add("max_force", value);
+    return 0;
+  }
+
+  void configure(const ForceFieldParameters& parameters)
+  {
+    // Device units: mm
+    k_ = parameters.values[stiffness_] / 1000.0;
+    b_ = parameters.values[damping_] / 1000.0;
+    for (int i = 0; i < 3; i++)
+      anchor_mm_[i] = parameters.values[anchor_ + i] * 1000.0;
+    limit_ = parameters.values[max_force_];
+  }
+
+  void update(const ForceFieldInput& in, double force[3], double torque[3])
+  {
+    double f[3];
+    for (int i = 0; i < 3; i++)
+      f[i] = k_ * (anchor_mm_[i] - in.position[i]) - b_ * in.velocity[i];
+    saturate(f, limit_);
+    for (int i = 0; i < 3; i++)
+      force[i] += f[i];
+  }
+
+private:
+  // Parameter indices
+  int stiffness_, damping_, anchor_, max_force_;
+
+  double k_, b_, anchor_mm_[3], limit_;
+};
+
+/*
+ * Viscous drag opposing the stylus velocity. Parameters: damping (Ns/m),
+ * max_force (N).
+ */
+class ViscousField : public ForceField
+{
+public:
+  int initialize(const ros::NodeHandle& pnode, ForceFieldParameters& parameters)
+  {
+    double value;
+    pnode.param(std::string("damping"), value, 2.0);
+    damping_ = parameters.add("damping", value);
+    pnode.param(std::string("max_force"), value, 1.0);
+    max_force_ = parameters.add("max_force", value);
+    return 0;
+  }
+
+  void configure(const ForceFieldParameters& parameters)
+  {
+    b_ = parameters.values[damping_] / 1000.0;
+    limit_ = parameters.values[max_force_];
+  }
+
+  void update(const ForceFieldInput& in, double force[3], double torque[3])
+  {
+    double f[3];
+    for (int i = 0; i < 3; i++)
+      f[i] = -b_ * in.velocity[i];
+    saturate(f, limit_);
+    for (int i = 0; i < 3; i++)
+      force[i] += f[i];
+  }
+
+private:
+  int damping_, max_force_;
+
+  double b_, limit_;
+};
+
+} // namespace sensable_phantom
+
+PLUGINLIB_EXPORT_CLASS(sensable_phantom::SpringField, sensable_phantom::ForceField)
+PLUGINLIB_EXPORT_CLASS(sensable_phantom::ViscousField, sensable_phantom::ForceField)
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include "sensable_phantom/frame_cache.h"
+
+namespace sensable_phantom
+{
+
+FrameCache::FrameCache(const tf::Transformer& transformer) : transformer_(transformer), cached_(false)
+{
+}
+
+void FrameCache::set_target_frame(const std::string& frame)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  target_frame_ = frame;
+  static_frames_.insert(normalize(frame));
+  cached_ = false;
+}
+
+void FrameCache::add_static_frame(const std::string& frame)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  static_frames_.insert(normalize(frame));
+}
+
+bool FrameCache::is_static(const std::string& frame) const
+{
+  return static_frames_.count(normalize(frame)) > 0;
+}
+
+void FrameCache::rotate(const std::string& frame, tf::Vector3& force, tf::Vector3& torque)
+{
+  tf::Matrix3x3 rotation;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (cached_ && frame == cached_frame_)
+    {
+      rotation = cached_rotation_;
+    }
+    else if (is_static(frame))
+    {
+      // Source frame changed; resolve it once and keep it
+      tf::StampedTransform transform;
+      transformer_.lookupTransform(target_frame_, frame, ros::Time(0), transform);
+      cached_rotation_ = rotation = transform.getBasis();
+      cached_frame_ = frame;
+      cached_ = true;
+    }
+    else
+    {
+      lock.unlock();
+      // Dynamic frame, ask tf every time
+      tf::StampedTransform transform;
+      transformer_.lookupTransform(target_frame_, frame, ros::Time(0), transform);
+      rotation = transform.getBasis();
+    }
+  }
+
+  force = rotation * force;
+  torque = rotation * torque;
+}
+
+std::string FrameCache::normalize(const std::string& frame)
+{
+  if (!frame.empty() && frame[0] == '/')
+    return frame.substr(1);
+  return frame;
+}
+
+} // namespace sensable_phantom
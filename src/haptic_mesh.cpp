@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "sensable_phantom/haptic_mesh.h"
+
+namespace sensable_phantom
+{
+
+// Proxy is kept this far above the surface so the next ray starts outside, mm
+static const double PROXY_EPSILON = 1e-3;
+static const uint32_t LEAF_SIZE = 4;
+static const int MAX_DEPTH = 64;
+
+static inline double dot(const double a[3], const double b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static inline void cross(const double a[3], const double b[3], double c[3])
+{
+  c[0] = a[1] * b[2] - a[2] * b[1];
+  c[1] = a[2] * b[0] - a[0] * b[2];
+  c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+namespace
+{
+
+struct CentroidLess
+{
+  CentroidLess(const std::vector<float>& centroids, int axis) : centroids(centroids), axis(axis)
+  {
+  }
+
+  bool operator()(uint32_t a, uint32_t b) const
+  {
+    return centroids[3 * a + axis] < centroids[3 * b + axis];
+  }
+
+  const std::vector<float>& centroids;
+  int axis;
+};
+
+} // namespace
+
+MeshModel::MeshModel(const TriangleMesh& mesh, double stiffness, double damping) :
+    stiffness_(stiffness), damping_(damping)
+{
+  uint32_t n = mesh.triangles();
+  if (n == 0)
+    return;
+
+  std::vector<float> centroids(3 * n);
+  std::vector<uint32_t> order(n);
+  for (uint32_t k = 0; k < n; k++)
+  {
+    order[k] = k;
+    for (int i = 0; i < 3; i++)
+      centroids[3 * k + i] = (mesh.vertices[3 * mesh.indices[3 * k] + i] + mesh.vertices[3 * mesh.indices[3 * k + 1] + i]
+          + mesh.vertices[3 * mesh.indices[3 * k + 2] + i]) / 3.0f;
+  }
+
+  // Median splits give a tree of depth ~log2(n / LEAF_SIZE), well below MAX_DEPTH
+  nodes_.reserve(2 * (n / LEAF_SIZE + 1));
+  build(order, centroids, mesh, 0, n);
+
+  // Leaves refer to consecutive triangles
+  triangles_.resize(n);
+  for (uint32_t k = 0; k < n; k++)
+  {
+    const uint32_t *idx = &mesh.indices[3 * order[k]];
+    const float *v0 = &mesh.vertices[3 * idx[0]];
+    const float *v1 = &mesh.vertices[3 * idx[1]];
+    const float *v2 = &mesh.vertices[3 * idx[2]];
+    Triangle& t = triangles_[k];
+    for (int i = 0; i < 3; i++)
+    {
+      t.v0[i] = v0[i];
+      t.e1[i] = v1[i] - v0[i];
+      t.e2[i] = v2[i] - v0[i];
+    }
+  }
+}
+
+uint32_t MeshModel::build(std::vector<uint32_t>& order, const std::vector<float>& centroids, const TriangleMesh& mesh,
+                          uint32_t begin, uint32_t end)
+{
+  uint32_t index = nodes_.size();
+  nodes_.push_back(Node());
+
+  Node node;
+  float cmin[3], cmax[3];
+  for (int i = 0; i < 3; i++)
+  {
+    node.min[i] = cmin[i] = HUGE_VALF;
+    node.max[i] = cmax[i] = -HUGE_VALF;
+  }
+  for (uint32_t k = begin; k < end; k++)
+  {
+    for (int j = 0; j < 3; j++)
+    {
+      const float *v = &mesh.vertices[3 * mesh.indices[3 * order[k] + j]];
+      for (int i = 0; i < 3; i++)
+      {
+        node.min[i] = std::min(node.min[i], v[i]);
+        node.max[i] = std::max(node.max[i], v[i]);
+      }
+    }
+    for (int i = 0; i < 3; i++)
+    {
+      cmin[i] = std::min(cmin[i], centroids[3 * order[k] + i]);
+      cmax[i] = std::max(cmax[i], centroids[3 * order[k] + i]);
+    }
+  }
+
+  if (end - begin <= LEAF_SIZE)
+  {
+    node.first = begin;
+    node.count = end - begin;
+    nodes_[index] = node;
+    return index;
+  }
+
+  // Split at the median along the longest extent of the centroids
+  int axis = 0;
+  for (int i = 1; i < 3; i++)
+  {
+    if (cmax[i] - cmin[i] > cmax[axis] - cmin[axis])
+      axis = i;
+  }
+  uint32_t middle = begin + (end - begin) / 2;
+  std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, CentroidLess(centroids, axis));
+
+  build(order, centroids, mesh, begin, middle);
+  node.first = build(order, centroids, mesh, middle, end);
+  node.count = 0;
+  nodes_[index] = node;
+  return index;
+}
+
+bool MeshModel::raycast(const double from[3], const double to[3], double& t, double normal[3]) const
+{
+  if (nodes_.empty())
+    return false;
+
+  double dir[3] = {to[0] - from[0], to[1] - from[1], to[2] - from[2]};
+  double inv[3];
+  for (int i = 0; i < 3; i++)
+    inv[i] = 1.0 / dir[i];
+
+  int best = -1;
+  double best_t = 1.0;
+
+  uint32_t stack[MAX_DEPTH];
+  int top = 0;
+  stack[top++] = 0;
+  while (top > 0)
+  {
+    uint32_t index = stack[--top];
+    const Node& node = nodes_[index];
+
+    // Slab test against [0, best_t]
+    double t0 = 0.0, t1 = best_t;
+    for (int i = 0; i < 3; i++)
+    {
+      double a = (node.min[i] - from[i]) * inv[i];
+      double b = (node.max[i] - from[i]) * inv[i];
+      if (a > b)
+        std::swap(a, b);
+      t0 = std::max(t0, a);
+      t1 = std::min(t1, b);
+    }
+    if (!(t0 <= t1))
+      continue;
+
+    if (node.count == 0)
+    {
+      if (top + 2 > MAX_DEPTH)
+        continue;
+      stack[top++] = node.first;
+      stack[top++] = index + 1;
+      continue;
+    }
+
+    // Moller-Trumbore, back faces culled so a proxy inside the mesh can leave
+    for (uint32_t k = node.first; k < node.first + node.count; k++)
+    {
+      const Triangle& tri = triangles_[k];
+      double e1[3] = {tri.e1[0], tri.e1[1], tri.e1[2]};
+      double e2[3] = {tri.e2[0], tri.e2[1], tri.e2[2]};
+      double p[3];
+      cross(dir, e2, p);
+      double det = dot(e1, p);
+      if (det <= 1e-12)
+        continue;
+
+      double s[3] = {from[0] - tri.v0[0], from[1] - tri.v0[1], from[2] - tri.v0[2]};
+      double u = dot(s, p);
+      if (u < 0.0 || u > det)
+        continue;
+      double q[3];
+      cross(s, e1, q);
+      double v = dot(dir, q);
+      if (v < 0.0 || u + v > det)
+        continue;
+      double hit_t = dot(e2, q) / det;
+      if (hit_t < 0.0 || hit_t > best_t)
+        continue;
+
+      best_t = hit_t;
+      best = k;
+    }
+  }
+
+  if (best < 0)
+    return false;
+
+  const Triangle& tri = triangles_[best];
+  double e1[3] = {tri.e1[0], tri.e1[1], tri.e1[2]};
+  double e2[3] = {tri.e2[0], tri.e2[1], tri.e2[2]};
+  cross(e1, e2, normal);
+  double len = sqrt(dot(normal, normal));
+  for (int i = 0; i < 3; i++)
+    normal[i] /= len;
+  t = best_t;
+  return true;
+}
+
+void MeshModel::render(const double position[3], const double velocity[3], MeshProxy& proxy, double force[3]) const
+{
+  if (!proxy.valid)
+  {
+    // Start where the tip is; from inside the mesh it walks out freely
+    for (int i = 0; i < 3; i++)
+      proxy.position[i] = position[i];
+    proxy.valid = true;
+  }
+
+  double pos[3] = {proxy.position[0], proxy.position[1], proxy.position[2]};
+  double goal[3] = {position[0], position[1], position[2]};
+  double normals[3][3];
+  int planes = 0;
+
+  // Each contact adds a constraint plane, and the goal is projected onto
+  // the planes found so far: slide on a face, along an edge, stop in a corner
+  while (planes < 3)
+  {
+    double step[3] = {goal[0] - pos[0], goal[1] - pos[1], goal[2] - pos[2]};
+    if (dot(step, step) < 1e-18)
+      break;
+
+    double t, *n = normals[planes];
+    if (!raycast(pos, goal, t, n))
+    {
+      for (int i = 0; i < 3; i++)
+        pos[i] = goal[i];
+      break;
+    }
+
+    double hit[3];
+    for (int i = 0; i < 3; i++)
+    {
+      hit[i] = pos[i] + t * step[i];
+      pos[i] = hit[i] + PROXY_EPSILON * n[i];
+    }
+    planes++;
+
+    if (planes == 1)
+    {
+      double depth = dot(n, goal) - dot(n, hit) - PROXY_EPSILON;
+      for (int i = 0; i < 3; i++)
+        goal[i] -= depth * n[i];
+    }
+    else if (planes == 2)
+    {
+      double line[3];
+      cross(normals[0], normals[1], line);
+      double len = sqrt(dot(line, line));
+      if (len < 1e-6)
+      {
+        // Parallel faces, the newer one is enough
+        double depth = dot(n, goal) - dot(n, hit) - PROXY_EPSILON;
+        for (int i = 0; i < 3; i++)
+          goal[i] -= depth * n[i];
+      }
+      else
+      {
+        double d[3] = {goal[0] - pos[0], goal[1] - pos[1], goal[2] - pos[2]};
+        double along = dot(d, line) / (len * len);
+        for (int i = 0; i < 3; i++)
+          goal[i] = pos[i] + along * line[i];
+      }
+    }
+  }
+
+  for (int i = 0; i < 3; i++)
+    proxy.position[i] = pos[i];
+
+  // Spring from the tip to the proxy, damped along the same direction
+  double d[3] = {pos[0] - position[0], pos[1] - position[1], pos[2] - position[2]};
+  double len = sqrt(dot(d, d));
+  proxy.contact = planes > 0 || len > PROXY_EPSILON;
+  if (len <= PROXY_EPSILON)
+    return;
+
+  for (int i = 0; i < 3; i++)
+    d[i] /= len;
+  double magnitude = stiffness_ * len - damping_ * dot(velocity, d);
+  if (magnitude <= 0.0)
+    return;
+  for (int i = 0; i < 3; i++)
+    force[i] += magnitude * d[i];
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <math.h>
+
+#include "sensable_phantom/haptic_scene.h"
+
+namespace sensable_phantom
+{
+
+static inline double dot(const double a[3], const double b[3])
+{
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Penetration depth and outward normal of the tip, false if not in contact
+static bool contact(const ScenePrimitive& p, const double position[3], double& depth, double normal[3])
+{
+  double d[3] = {position[0] - p.center[0], position[1] - p.center[1], position[2] - p.center[2]};
+
+  switch (p.type)
+  {
+    case ScenePrimitive::PLANE:
+    {
+      depth = -dot(d, p.axes[0]);
+      if (depth <= 0.0)
+        return false;
+      for (int i = 0; i < 3; i++)
+        normal[i] = p.axes[0][i];
+      return true;
+    }
+
+    case ScenePrimitive::SPHERE:
+    {
+      double r = sqrt(dot(d, d));
+      depth = p.size[0] - r;
+      if (depth <= 0.0)
+        return false;
+      if (r < 1e-9)
+      {
+        // Dead center, any direction will do
+        normal[0] = 0.0;
+        normal[1] = 0.0;
+        normal[2] = 1.0;
+        return true;
+      }
+      for (int i = 0; i < 3; i++)
+        normal[i] = d[i] / r;
+      return true;
+    }
+
+    case ScenePrimitive::BOX:
+    {
+      // Leave through the face that is closest
+      depth = -1.0;
+      int axis = 0;
+      double sign = 1.0;
+      for (int i = 0; i < 3; i++)
+      {
+        double local = dot(d, p.axes[i]);
+        double face = p.size[i] - fabs(local);
+        if (face <= 0.0)
+          return false;
+        if (depth < 0.0 || face < depth)
+        {
+          depth = face;
+          axis = i;
+          sign = local < 0.0 ? -1.0 : 1.0;
+        }
+      }
+      for (int i = 0; i < 3; i++)
+        normal[i] = sign * p.axes[axis][i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void PrimitiveScene::render(const double position[3], const double velocity[3], double force[3]) const
+{
+  for (int k = 0; k < count; k++)
+  {
+    const ScenePrimitive& p = primitives[k];
+    double depth, normal[3];
+    if (!contact(p, position, depth, normal))
+      continue;
+
+    // Spring pushes out, damper resists motion along the normal; never pull in
+    double magnitude = p.stiffness * depth - p.damping * dot(velocity, normal);
+    if (magnitude <= 0.0)
+      continue;
+    for (int i = 0; i < 3; i++)
+      force[i] += magnitude * normal[i];
+  }
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,244 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+#include <ros/ros.h>
+
+#include <vector>
+
+#include <HD/hd.h>
+#include <HDU/hduError.h>
+
+#include "sensable_phantom/phantom_device.h"
+
+namespace sensable_phantom
+{
+
+class HDDevice : public PhantomDevice
+{
+public:
+  HDDevice(HHD handle, const std::string& model, int output_dof, bool legacy_torque_units) :
+      handle_(handle), model_(model), output_dof_(output_dof), legacy_torque_units_(legacy_torque_units),
+      last_error_(0)
+  {
+  }
+
+  ~HDDevice()
+  {
+    hdDisableDevice(handle_);
+  }
+
+  // Read once in open(): querying it from a ROS thread would change the
+  // current device under the servo callback
+  std::string model() const
+  {
+    return model_;
+  }
+
+  /*******************************************************************************
+   Automatic Calibration of Phantom Device - No character inputs
+   *******************************************************************************/
+  void calibrate()
+  {
+    int calibrationStyle = 0;
+    int supportedCalibrationStyles;
+    HDErrorInfo error;
+
+    hdMakeCurrentDevice(handle_);
+    hdGetIntegerv(HD_CALIBRATION_STYLE, &supportedCalibrationStyles);
+    if (supportedCalibrationStyles & HD_CALIBRATION_ENCODER_RESET)
+    {
+      calibrationStyle = HD_CALIBRATION_ENCODER_RESET;
+      ROS_INFO("HD_CALIBRATION_ENCODER_RESET...");
+    }
+    if (supportedCalibrationStyles & HD_CALIBRATION_INKWELL)
+    {
+      calibrationStyle = HD_CALIBRATION_INKWELL;
+      ROS_INFO("HD_CALIBRATION_INKWELL...");
+    }
+    if (supportedCalibrationStyles & HD_CALIBRATION_AUTO)
+    {
+      calibrationStyle = HD_CALIBRATION_AUTO;
+      ROS_INFO("HD_CALIBRATION_AUTO...");
+    }
+
+    do
+    {
+      hdUpdateCalibration(calibrationStyle);
+      ROS_INFO("Calibrating... (put stylus in well)");
+      if (HD_DEVICE_ERROR(error = hdGetError()))
+      {
+        hduPrintError(stderr, &error, "Reset encoders reset failed.");
+        break;
+      }
+    } while (hdCheckCalibration() != HD_CALIBRATION_OK);
+
+    ROS_INFO("Calibration complete.");
+  }
+
+  void begin_frame()
+  {
+    hdMakeCurrentDevice(handle_);
+    hdBeginFrame(handle_);
+  }
+
+  void read(DeviceInput& in)
+  {
+    hdGetDoublev(HD_CURRENT_GIMBAL_ANGLES, in.gimbal);
+    hdGetDoublev(HD_CURRENT_POSITION, in.position);
+    hdGetDoublev(HD_CURRENT_JOINT_ANGLES, in.joints);
+    hdGetDoublev(HD_CURRENT_TRANSFORM, in.transform);
+
+    int nButtons = 0;
+    hdGetIntegerv(HD_CURRENT_BUTTONS, &nButtons);
+    in.buttons = ((nButtons & HD_DEVICE_BUTTON_1) ? BUTTON_1 : 0) | ((nButtons & HD_DEVICE_BUTTON_2) ? BUTTON_2 : 0);
+  }
+
+  void write(const DeviceOutput& out)
+  {
+    hdSetDoublev(HD_CURRENT_FORCE, out.force);
+
+    double torque_mnm[3];
+    hd_torque(out, output_dof_ == 6, legacy_torque_units_, torque_mnm);
+    hdSetDoublev(output_dof_ == 6 ? HD_CURRENT_GIMBAL_TORQUE : HD_CURRENT_TORQUE, torque_mnm);
+  }
+
+  bool end_frame()
+  {
+    hdEndFrame(handle_);
+
+    HDErrorInfo error;
+    last_error_ = 0;
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+      last_error_ = error.errorCode;
+      hduPrintError(stderr, &error, "Error during main scheduler callback\n");
+      if (hduIsSchedulerError(&error))
+        return false;
+    }
+    return true;
+  }
+
+  int last_error() const
+  {
+    return last_error_;
+  }
+
+  bool has_gimbal_torque() const
+  {
+    return output_dof_ == 6;
+  }
+
+private:
+  HHD handle_;
+  std::string model_;
+  int output_dof_; // 3, or 6 with actuated gimbal
+  bool legacy_torque_units_;
+  int last_error_;
+};
+
+class HDBackend : public PhantomBackend
+{
+public:
+  explicit HDBackend(bool legacy_torque_units) : legacy_torque_units_(legacy_torque_units), started_(false)
+  {
+  }
+
+  ~HDBackend()
+  {
+    stop();
+    for (size_t i = 0; i < devices_.size(); i++)
+      delete devices_[i];
+    for (size_t i = 0; i < callbacks_.size(); i++)
+      delete callbacks_[i];
+  }
+
+  PhantomDevice* open(const std::string& name)
+  {
+    HDErrorInfo error;
+    HHD handle = hdInitDevice(name.empty() ? HD_DEFAULT_DEVICE : name.c_str());
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+      ROS_ERROR("Failed to initialize haptic device '%s'", name.c_str());
+      return NULL;
+    }
+    hdEnable(HD_FORCE_OUTPUT);
+    //   hdEnable(HD_MAX_FORCE_CLAMPING);
+
+    // The scheduler is not running yet, so the new device is still current
+    std::string model = hdGetString(HD_DEVICE_MODEL_TYPE);
+    int output_dof = 3;
+    hdGetIntegerv(HD_OUTPUT_DOF, &output_dof);
+
+    HDDevice *device = new HDDevice(handle, model, output_dof, legacy_torque_units_);
+    devices_.push_back(device);
+    return device;
+  }
+
+  bool start()
+  {
+    HDErrorInfo error;
+    hdStartScheduler();
+    if (HD_DEVICE_ERROR(error = hdGetError()))
+    {
+      ROS_ERROR("Failed to start the scheduler");
+      return false;
+    }
+    started_ = true;
+    return true;
+  }
+
+  void stop()
+  {
+    if (started_)
+    {
+      hdStopScheduler();
+      started_ = false;
+    }
+  }
+
+  void schedule(ServoCallback callback, void *user_data)
+  {
+    Callback *cb = new Callback;
+    cb->callback = callback;
+    cb->user_data = user_data;
+    callbacks_.push_back(cb);
+    hdScheduleAsynchronous(&HDBackend::dispatch, cb, HD_MAX_SCHEDULER_PRIORITY);
+  }
+
+  double update_rate() const
+  {
+    int rate = 0;
+    hdGetIntegerv(HD_UPDATE_RATE, &rate);
+    return rate > 0 ? rate : 1000.0;
+  }
+
+private:
+  struct Callback
+  {
+    ServoCallback callback;
+    void *user_data;
+  };
+
+  static HDCallbackCode HDCALLBACK dispatch(void *pUserData)
+  {
+    Callback *cb = static_cast<Callback *>(pUserData);
+    return cb->callback(cb->user_data) ? HD_CALLBACK_CONTINUE : HD_CALLBACK_DONE;
+  }
+
+  bool legacy_torque_units_;
+  bool started_;
+  std::vector<HDDevice *> devices_;
+  std::vector<Callback *> callbacks_;
+};
+
+PhantomBackend* create_hd_backend(bool legacy_torque_units)
+{
+  return new HDBackend(legacy_torque_units);
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <string.h>
+
+#include "sensable_phantom/kalman_estimator.h"
+
+namespace sensable_phantom
+{
+
+KalmanEstimator::KalmanEstimator() : dt_(0.0), r_(0.0), primed_(false)
+{
+  // 1 kHz, ~20 Hz tracking bandwidth with positions in mm
+  configure(1000.0, 4e9, 0.03);
+}
+
+int KalmanEstimator::configure(double rate, double jerk_psd, double position_sigma)
+{
+  if (rate <= 0.0 || jerk_psd <= 0.0 || position_sigma <= 0.0)
+    return -1;
+
+  double dt = 1.0 / rate;
+  double dt2 = dt * dt, dt3 = dt2 * dt, dt4 = dt3 * dt, dt5 = dt4 * dt;
+  dt_ = dt;
+
+  // Discretized white jerk
+  q_[0][0] = jerk_psd * dt5 / 20.0;
+  q_[0][1] = q_[1][0] = jerk_psd * dt4 / 8.0;
+  q_[0][2] = q_[2][0] = jerk_psd * dt3 / 6.0;
+  q_[1][1] = jerk_psd * dt3 / 3.0;
+  q_[1][2] = q_[2][1] = jerk_psd * dt2 / 2.0;
+  q_[2][2] = jerk_psd * dt;
+  r_ = position_sigma * position_sigma;
+
+  reset();
+  return 0;
+}
+
+void KalmanEstimator::reset()
+{
+  primed_ = false;
+  memset(x_, 0, sizeof(x_));
+  memset(p_, 0, sizeof(p_));
+}
+
+void KalmanEstimator::step(const double position[3], double velocity[3], double acceleration[3])
+{
+  if (!primed_)
+  {
+    // Position known to measurement accuracy, motion unknown but bounded
+    memset(p_, 0, sizeof(p_));
+    p_[0][0] = r_;
+    p_[1][1] = 1e3 * r_ / (dt_ * dt_);
+    p_[2][2] = 1e3 * r_ / (dt_ * dt_ * dt_ * dt_);
+    for (int i = 0; i < 3; i++)
+    {
+      x_[i][0] = position[i];
+      x_[i][1] = 0.0;
+      x_[i][2] = 0.0;
+      velocity[i] = 0.0;
+      acceleration[i] = 0.0;
+    }
+    primed_ = true;
+    return;
+  }
+
+  // Predict covariance: P = F P F' + Q, F = [1 dt dt^2/2; 0 1 dt; 0 0 1]
+  const double f[3][3] = {{1.0, dt_, 0.5 * dt_ * dt_}, {0.0, 1.0, dt_}, {0.0, 0.0, 1.0}};
+  double fp[3][3];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      fp[r][c] = f[r][0] * p_[0][c] + f[r][1] * p_[1][c] + f[r][2] * p_[2][c];
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      p_[r][c] = fp[r][0] * f[c][0] + fp[r][1] * f[c][1] + fp[r][2] * f[c][2] + q_[r][c];
+
+  // Gain for H = [1 0 0]
+  double s = p_[0][0] + r_;
+  double k[3] = {p_[0][0] / s, p_[1][0] / s, p_[2][0] / s};
+
+  // Update covariance: P = (I - K H) P
+  double p0[3] = {p_[0][0], p_[0][1], p_[0][2]};
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      p_[r][c] -= k[r] * p0[c];
+
+  for (int i = 0; i < 3; i++)
+  {
+    double *x = x_[i];
+    // Predict state
+    double p = x[0] + dt_ * x[1] + 0.5 * dt_ * dt_ * x[2];
+    double v = x[1] + dt_ * x[2];
+    double a = x[2];
+    // Correct with the measured position
+    double innovation = position[i] - p;
+    x[0] = p + k[0] * innovation;
+    x[1] = v + k[1] * innovation;
+    x[2] = a + k[2] * innovation;
+    velocity[i] = x[1];
+    acceleration[i] = x[2];
+  }
+}
+
+} // namespace sensable_phantom
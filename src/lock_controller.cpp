@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sensable_phantom/lock_controller.h"
+
+namespace sensable_phantom
+{
+
+// The gains the driver always used, with a limit just below the Omni's peak force
+LockGains::LockGains() :
+    stiffness(0.04), damping(0.001), max_force(3.0), ramp_time(0.5)
+{
+}
+
+LockController::LockController() :
+    engaged_(false), elapsed_(0.0)
+{
+  memset(anchor_, 0, sizeof(anchor_));
+}
+
+bool LockController::update(bool locked, const LockGains& gains, const double position[3], const double velocity[3],
+                            double dt, double force[3])
+{
+  if (!locked)
+  {
+    engaged_ = false;
+    return false;
+  }
+
+  if (!engaged_)
+  {
+    memcpy(anchor_, position, sizeof(anchor_));
+    elapsed_ = 0.0;
+    engaged_ = true;
+  }
+  else
+    elapsed_ += dt;
+
+  double norm = 0.0;
+  for (int i = 0; i < 3; i++)
+  {
+    force[i] = gains.stiffness * (anchor_[i] - position[i]) - gains.damping * velocity[i];
+    norm += force[i] * force[i];
+  }
+  norm = sqrt(norm);
+
+  double scale = 1.0;
+  if (gains.ramp_time > 0.0 && elapsed_ < gains.ramp_time)
+    scale = elapsed_ / gains.ramp_time;
+  if (norm * scale > gains.max_force)
+    scale = gains.max_force / norm;
+  for (int i = 0; i < 3; i++)
+    force[i] *= scale;
+  return true;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,343 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <sstream>
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/haptic_mesh.h"
+
+namespace sensable_phantom
+{
+
+static std::string extension(const std::string& path)
+{
+  size_t dot = path.rfind('.');
+  std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); i++)
+    ext[i] = tolower(ext[i]);
+  return ext;
+}
+
+// STL has no shared vertices; every facet brings its own three
+static int load_stl(std::ifstream& file, const std::string& path, TriangleMesh& mesh)
+{
+  file.seekg(0, std::ios::end);
+  size_t size = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  // Binary STL: 80 byte header, facet count and 50 bytes per facet. ASCII
+  // files may also start with "solid", so the size is what decides.
+  char header[80];
+  uint32_t count = 0;
+  if (size >= 84 && file.read(header, 80) && file.read((char *)&count, 4) && size == 84 + 50 * (size_t)count)
+  {
+    mesh.vertices.resize(9 * (size_t)count);
+    mesh.indices.resize(3 * (size_t)count);
+    char facet[50];
+    for (uint32_t k = 0; k < count; k++)
+    {
+      if (!file.read(facet, 50))
+        break;
+      // Skip the normal, it is recomputed from the winding
+      memcpy(&mesh.vertices[9 * (size_t)k], facet + 12, 36);
+      for (int j = 0; j < 3; j++)
+        mesh.indices[3 * (size_t)k + j] = 3 * k + j;
+    }
+    if (!file)
+    {
+      ROS_ERROR("Truncated STL file %s", path.c_str());
+      return -1;
+    }
+    return 0;
+  }
+
+  file.clear();
+  file.seekg(0, std::ios::beg);
+  std::string word;
+  while (file >> word)
+  {
+    if (word != "vertex")
+      continue;
+    float v[3];
+    if (!(file >> v[0] >> v[1] >> v[2]))
+    {
+      ROS_ERROR("Malformed vertex in STL file %s", path.c_str());
+      return -1;
+    }
+    mesh.indices.push_back(mesh.vertices.size() / 3);
+    mesh.vertices.insert(mesh.vertices.end(), v, v + 3);
+  }
+  if (mesh.indices.size() % 3)
+  {
+    ROS_ERROR("STL file %s has incomplete facets", path.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+namespace
+{
+
+struct PlyProperty
+{
+  std::string name;
+  std::string type;
+  std::string count_type; // non-empty for lists
+};
+
+struct PlyElement
+{
+  std::string name;
+  size_t count;
+  std::vector<PlyProperty> properties;
+};
+
+} // namespace
+
+static size_t ply_size(const std::string& type)
+{
+  if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+    return 1;
+  if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+    return 2;
+  if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32")
+    return 4;
+  if (type == "double" || type == "float64")
+    return 8;
+  return 0;
+}
+
+// One scalar of the given type, as double
+static bool ply_read(std::ifstream& file, bool binary, const std::string& type, double& value)
+{
+  if (!binary)
+    return (bool)(file >> value);
+
+  unsigned char buf[8];
+  size_t size = ply_size(type);
+  if (!file.read((char *)buf, size))
+    return false;
+
+  if (type == "char" || type == "int8")
+    value = *(int8_t *)buf;
+  else if (type == "uchar" || type == "uint8")
+    value = *(uint8_t *)buf;
+  else if (type == "short" || type == "int16")
+    value = *(int16_t *)buf;
+  else if (type == "ushort" || type == "uint16")
+    value = *(uint16_t *)buf;
+  else if (type == "int" || type == "int32")
+    value = *(int32_t *)buf;
+  else if (type == "uint" || type == "uint32")
+    value = *(uint32_t *)buf;
+  else if (type == "float" || type == "float32")
+    value = *(float *)buf;
+  else
+    value = *(double *)buf;
+  return true;
+}
+
+static int truncated(const std::string& path)
+{
+  ROS_ERROR("Truncated PLY file %s", path.c_str());
+  return -1;
+}
+
+// ASCII and little-endian binary PLY; vertex x, y, z and face vertex lists are used
+static int load_ply(std::ifstream& file, const std::string& path, TriangleMesh& mesh)
+{
+  file.seekg(0, std::ios::end);
+  size_t file_size = file.tellg();
+  file.seekg(0, std::ios::beg);
+
+  std::string line;
+  if (!std::getline(file, line) || line.compare(0, 3, "ply") != 0)
+  {
+    ROS_ERROR("%s is not a PLY file", path.c_str());
+    return -1;
+  }
+
+  bool binary = false;
+  std::vector<PlyElement> elements;
+  while (std::getline(file, line))
+  {
+    std::istringstream stream(line);
+    std::string keyword;
+    stream >> keyword;
+    if (keyword == "format")
+    {
+      std::string format;
+      stream >> format;
+      if (format == "binary_little_endian")
+        binary = true;
+      else if (format != "ascii")
+      {
+        ROS_ERROR("Unsupported PLY format %s in %s", format.c_str(), path.c_str());
+        return -1;
+      }
+    }
+    else if (keyword == "element")
+    {
+      // Read signed, so that a negative count is not wrapped into a huge one
+      PlyElement element;
+      long long count = -1;
+      stream >> element.name >> count;
+      if (!stream || count < 0)
+      {
+        ROS_ERROR("Invalid PLY element count in %s: %s", path.c_str(), line.c_str());
+        return -1;
+      }
+      element.count = count;
+      elements.push_back(element);
+    }
+    else if (keyword == "property" && !elements.empty())
+    {
+      PlyProperty property;
+      stream >> property.type;
+      if (property.type == "list")
+        stream >> property.count_type >> property.type;
+      stream >> property.name;
+      if (ply_size(property.type) == 0 || (!property.count_type.empty() && ply_size(property.count_type) == 0))
+      {
+        ROS_ERROR("Unsupported PLY property type in %s: %s", path.c_str(), line.c_str());
+        return -1;
+      }
+      elements.back().properties.push_back(property);
+    }
+    else if (keyword == "end_header")
+      break;
+  }
+
+  // Every value takes at least a byte (binary: its size, ASCII: a digit), so
+  // no count may exceed what is left of the file; this bounds every
+  // allocation below by the file size
+  size_t header_end = file.tellg();
+  size_t remaining = file_size > header_end ? file_size - header_end : 0;
+  size_t needed = 0;
+  for (size_t e = 0; e < elements.size(); e++)
+  {
+    const PlyElement& element = elements[e];
+    size_t record = 0;
+    for (size_t p = 0; p < element.properties.size(); p++)
+    {
+      const PlyProperty& property = element.properties[p];
+      record += binary ? ply_size(property.count_type.empty() ? property.type : property.count_type) : 1;
+    }
+    if (element.count > 0 && (record == 0 || element.count > (remaining - needed) / record))
+    {
+      ROS_ERROR("PLY file %s declares %zu %s elements, more than it can hold", path.c_str(), element.count,
+                element.name.c_str());
+      return -1;
+    }
+    needed += element.count * record;
+  }
+
+  size_t vertex_count = 0;
+  for (size_t e = 0; e < elements.size(); e++)
+  {
+    const PlyElement& element = elements[e];
+    bool vertex = element.name == "vertex";
+    bool face = element.name == "face";
+    if (vertex)
+    {
+      vertex_count = element.count;
+      mesh.vertices.resize(3 * vertex_count);
+    }
+
+    std::vector<double> list;
+    for (size_t k = 0; k < element.count; k++)
+    {
+      for (size_t p = 0; p < element.properties.size(); p++)
+      {
+        const PlyProperty& property = element.properties[p];
+        double value;
+        if (property.count_type.empty())
+        {
+          if (!ply_read(file, binary, property.type, value))
+            return truncated(path);
+          if (vertex && property.name.size() == 1 && property.name[0] >= 'x' && property.name[0] <= 'z')
+            mesh.vertices[3 * k + property.name[0] - 'x'] = value;
+          continue;
+        }
+
+        double count;
+        if (!ply_read(file, binary, property.count_type, count))
+          return truncated(path);
+        if (!(count >= 0.0 && count <= (double)remaining) || count != floor(count))
+        {
+          ROS_ERROR("Invalid PLY list length %g in %s", count, path.c_str());
+          return -1;
+        }
+        list.resize((size_t)count);
+        for (size_t i = 0; i < list.size(); i++)
+        {
+          if (!ply_read(file, binary, property.type, list[i]))
+            return truncated(path);
+        }
+
+        if (face && (property.name == "vertex_indices" || property.name == "vertex_index"))
+        {
+          // Fan triangulation
+          for (size_t i = 0; i < list.size(); i++)
+          {
+            // Checked before the conversion, which is undefined out of range
+            if (!(list[i] >= 0.0 && list[i] < (double)vertex_count))
+            {
+              ROS_ERROR("PLY file %s refers to vertex %g of %zu", path.c_str(), list[i], vertex_count);
+              return -1;
+            }
+          }
+          for (size_t i = 2; i < list.size(); i++)
+          {
+            uint32_t tri[3] = {(uint32_t)list[0], (uint32_t)list[i - 1], (uint32_t)list[i]};
+            mesh.indices.insert(mesh.indices.end(), tri, tri + 3);
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+int load_mesh(const std::string& path, TriangleMesh& mesh)
+{
+  mesh.vertices.clear();
+  mesh.indices.clear();
+
+  std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+  {
+    ROS_ERROR("Cannot open mesh file %s", path.c_str());
+    return -1;
+  }
+
+  std::string ext = extension(path);
+  int ret;
+  if (ext == "stl")
+    ret = load_stl(file, path, mesh);
+  else if (ext == "ply")
+    ret = load_ply(file, path, mesh);
+  else
+  {
+    ROS_ERROR("Unknown mesh format of %s, expected .stl or .ply", path.c_str());
+    return -1;
+  }
+
+  if (ret == 0 && mesh.triangles() == 0)
+  {
+    ROS_ERROR("Mesh file %s has no triangles", path.c_str());
+    return -1;
+  }
+  return ret;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/phantom_device.h"
+#include "sensable_phantom/replay_backend.h"
+#include "sensable_phantom/sim_backend.h"
+
+namespace sensable_phantom
+{
+
+#ifdef SENSABLE_PHANTOM_HAVE_OPENHAPTICS
+PhantomBackend* create_hd_backend(bool legacy_torque_units);
+#endif
+
+void hd_torque(const DeviceOutput& out, bool gimbal, bool legacy_units, double torque_mnm[3])
+{
+  const double *torque = gimbal ? out.gimbal_torque : out.torque;
+  double scale = (legacy_units && !gimbal) ? 1.0 : 1000.0;
+  for (int i = 0; i < 3; i++)
+    torque_mnm[i] = scale * torque[i];
+}
+
+PhantomBackend* create_backend(const std::string& type, const ros::NodeHandle& nh)
+{
+  if (type == "openhaptics")
+  {
+#ifdef SENSABLE_PHANTOM_HAVE_OPENHAPTICS
+    // Until this release, 3-DoF devices took the commanded torque unscaled, as mNm
+    bool legacy_torque_units = false;
+    if (!nh.getParam(std::string("openhaptics/legacy_torque_units"), legacy_torque_units))
+      ROS_WARN("Torque is now in Nm and scaled to mNm for the device; it used to be passed through as mNm. "
+               "Set ~openhaptics/legacy_torque_units to true to keep the old units, or false to silence this.");
+    else if (legacy_torque_units)
+      ROS_WARN("~openhaptics/legacy_torque_units is set: torque is taken as mNm on 3-DoF devices. "
+               "It will be removed in the next release; send torque in Nm.");
+    return create_hd_backend(legacy_torque_units);
+#else
+    ROS_ERROR("OpenHaptics backend was not compiled in, use backend:=sim");
+    return NULL;
+#endif
+  }
+
+  if (type == "sim")
+  {
+    SimConfig config;
+    std::vector<double> amplitude;
+    nh.param(std::string("sim/model"), config.model, config.model);
+    nh.param(std::string("sim/rate"), config.rate, config.rate);
+    if (nh.getParam(std::string("sim/amplitude"), amplitude) && amplitude.size() == 3)
+    {
+      for (int i = 0; i < 3; i++)
+        config.amplitude[i] = amplitude[i];
+    }
+    nh.param(std::string("sim/frequency"), config.frequency, config.frequency);
+    nh.param(std::string("sim/gimbal_amplitude"), config.gimbal_amplitude, config.gimbal_amplitude);
+    nh.param(std::string("sim/mass"), config.mass, config.mass);
+    nh.param(std::string("sim/stiffness"), config.stiffness, config.stiffness);
+    nh.param(std::string("sim/damping"), config.damping, config.damping);
+    nh.param(std::string("sim/max_force"), config.max_force, config.max_force);
+    nh.param(std::string("sim/button_period"), config.button_period, config.button_period);
+    if (config.rate <= 0)
+    {
+      ROS_ERROR("sim/rate must be positive");
+      return NULL;
+    }
+    return new SimBackend(config);
+  }
+
+  if (type == "replay")
+  {
+    ReplayConfig config;
+    // replay/files lists one trajectory per device, replay/file is enough for one
+    if (!nh.getParam(std::string("replay/files"), config.files))
+    {
+      std::string file;
+      if (nh.getParam(std::string("replay/file"), file))
+        config.files.push_back(file);
+    }
+    nh.param(std::string("replay/csv_rate"), config.csv_rate, config.csv_rate);
+    nh.param(std::string("replay/realtime"), config.realtime, config.realtime);
+    nh.param(std::string("replay/loop"), config.loop, config.loop);
+    nh.param(std::string("replay/shutdown"), config.shutdown, !config.loop);
+    nh.param(std::string("replay/output"), config.output_file, config.output_file);
+    if (config.files.empty())
+    {
+      ROS_ERROR("replay backend needs replay/file or replay/files");
+      return NULL;
+    }
+    if (config.csv_rate <= 0)
+    {
+      ROS_ERROR("replay/csv_rate must be positive");
+      return NULL;
+    }
+    return new ReplayBackend(config);
+  }
+
+  ROS_ERROR("Unknown device backend '%s'", type.c_str());
+  return NULL;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "sensable_phantom/phantom_driver.h"
+
+namespace sensable_phantom
+{
+
+PhantomDriver::PhantomDriver()
+{
+}
+
+PhantomDriver::~PhantomDriver()
+{
+  stop();
+  for (size_t i = 0; i < devices_.size(); i++)
+    delete devices_[i];
+}
+
+int PhantomDriver::init(const ros::NodeHandle& node, const ros::NodeHandle& pnode)
+{
+  ////////////////////////////////////////////////////////////////
+  // Init Phantom
+  ////////////////////////////////////////////////////////////////
+  std::string backend_type, device_name;
+  std::vector<std::string> device_names;
+  // "openhaptics" drives a real device, "sim" a simulated one
+  pnode.param(std::string("backend"), backend_type, std::string("openhaptics"));
+  // OpenHaptics device name as configured in Phantom Configuration; empty for the default device
+  pnode.param(std::string("device_name"), device_name, std::string(""));
+  // Several devices driven by this process, e.g. [left, right]
+  pnode.getParam(std::string("device_names"), device_names);
+  bool multi = !device_names.empty();
+  if (!multi)
+    device_names.push_back(device_name);
+
+  if (realtime_.load(pnode))
+    return -1;
+  if (realtime_.enabled && realtime_.lock_memory)
+  {
+    int ret = lock_memory();
+    if (ret)
+      ROS_WARN("Real-time: failed to lock memory: %s", strerror(ret));
+    else
+      ROS_INFO("Real-time: memory locked");
+  }
+
+  backend_.reset(create_backend(backend_type, pnode));
+  if (!backend_)
+    return -1;
+
+  // All devices have to be opened before the scheduler starts
+  for (size_t i = 0; i < device_names.size(); i++)
+  {
+    Device *device = new Device;
+    devices_.push_back(device);
+    device->name = device_names[i];
+    device->state.device = backend_->open(device->name);
+    if (!device->state.device)
+      return -1;
+
+    ROS_INFO("Found %s", device->state.device->model().c_str());
+    device->state.servo_rate = backend_->update_rate();
+    device->state.measured_rate = backend_->paced();
+  }
+
+  if (!backend_->start())
+    return -1;
+
+  ////////////////////////////////////////////////////////////////
+  // Init ROS
+  ////////////////////////////////////////////////////////////////
+  for (size_t i = 0; i < devices_.size(); i++)
+  {
+    Device *device = devices_[i];
+    ros::NodeHandle device_node = multi ? ros::NodeHandle(node, device->name) : node;
+    ros::NodeHandle device_pnode = multi ? ros::NodeHandle(pnode, device->name) : pnode;
+    if (multi && !device_pnode.hasParam("tf_prefix"))
+      device_pnode.setParam("tf_prefix", device->name);
+
+    if(device->phantom_ros.init(&device->state, device_node, device_pnode))
+    {
+      backend_->stop();
+      return -1;
+    }
+
+    if(device->phantom_ros.calibrate_)
+    {
+      device->state.device->calibrate();
+    }
+
+    group_.states.push_back(&device->state);
+    group_.active.push_back(1);
+    device->stack_prefault = realtime_.enabled ? realtime_.stack_prefault : 0;
+  }
+  group_.realtime = realtime_;
+
+  return 0;
+}
+
+int PhantomDriver::start()
+{
+  // One callback for all devices
+  backend_->schedule(phantom_group_callback, &group_);
+
+  if (realtime_.enabled)
+  {
+    // The servo thread reports back from its first tick
+    for (int i = 0; i < 1000 && group_.servo_setup.load(std::memory_order_acquire) == 0; i++)
+      usleep(1000);
+    int ret = group_.servo_setup.load(std::memory_order_acquire);
+    std::string setting = describe_realtime(realtime_.servo_priority, realtime_.servo_cpu);
+    if (ret == 0)
+      ROS_WARN("Real-time: servo thread did not run yet, %s not confirmed", setting.c_str());
+    else if (ret < 0)
+      ROS_WARN("Real-time: failed to set servo thread to %s: %s", setting.c_str(), strerror(-ret));
+    else
+      ROS_INFO("Real-time: servo thread %s", setting.c_str());
+  }
+
+  ////////////////////////////////////////////////////////////////
+  // Loop and publish
+  ////////////////////////////////////////////////////////////////
+  for (size_t i = 0; i < devices_.size(); i++)
+  {
+    Device *device = devices_[i];
+    if (pthread_create(&device->publish_thread, NULL, &PhantomDriver::publish_thread, device) != 0)
+    {
+      ROS_ERROR("Failed to start the publisher thread");
+      return -1;
+    }
+    device->publishing = true;
+
+    if (realtime_.enabled)
+    {
+      std::string setting = describe_realtime(realtime_.publish_priority, realtime_.publish_cpu);
+      int ret = set_thread_realtime(device->publish_thread, realtime_.publish_priority, realtime_.publish_cpu);
+      if (ret)
+        ROS_WARN("Real-time: failed to set publisher thread to %s: %s", setting.c_str(), strerror(ret));
+      else
+        ROS_INFO("Real-time: publisher thread %s", setting.c_str());
+    }
+  }
+  return 0;
+}
+
+void PhantomDriver::setup_callback_thread()
+{
+  if (!realtime_.enabled)
+    return;
+
+  prefault_stack(realtime_.stack_prefault);
+  std::string setting = describe_realtime(realtime_.callback_priority, realtime_.callback_cpu);
+  int ret = set_thread_realtime(pthread_self(), realtime_.callback_priority, realtime_.callback_cpu);
+  if (ret)
+    ROS_WARN("Real-time: failed to set callback threads to %s: %s", setting.c_str(), strerror(ret));
+  else
+    ROS_INFO("Real-time: callback threads %s", setting.c_str());
+}
+
+void PhantomDriver::stop()
+{
+  for (size_t i = 0; i < devices_.size(); i++)
+  {
+    Device *device = devices_[i];
+    device->phantom_ros.stop();
+    if (device->publishing)
+    {
+      pthread_join(device->publish_thread, NULL);
+      device->publishing = false;
+    }
+  }
+
+  if (backend_)
+  {
+    ROS_INFO("Ending Session...");
+    backend_->stop();
+    backend_.reset();
+  }
+}
+
+void *PhantomDriver::publish_thread(void *ptr)
+{
+  Device *device = static_cast<Device *>(ptr);
+  prefault_stack(device->stack_prefault);
+  device->phantom_ros.publish_loop();
+  return NULL;
+}
+
+} // namespace sensable_phantom
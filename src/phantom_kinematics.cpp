@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+#include <ctype.h>
+#include <math.h>
+
+#include "sensable_phantom/phantom_kinematics.h"
+
+namespace sensable_phantom
+{
+
+int default_link_lengths(const std::string& model, double lengths[2])
+{
+  std::string m = model;
+  for (size_t i = 0; i < m.size(); i++)
+    m[i] = tolower(m[i]);
+
+  if (m.find("omni") != std::string::npos)
+  {
+    lengths[0] = 0.131;
+    lengths[1] = 0.137;
+  }
+  else if (m.find("premium 1.5") != std::string::npos)
+  {
+    lengths[0] = 0.215;
+    lengths[1] = 0.215;
+  }
+  else if (m.find("premium 3.0") != std::string::npos)
+  {
+    lengths[0] = 0.457;
+    lengths[1] = 0.457;
+  }
+  else
+    return -1;
+  return 0;
+}
+
+static inline void set(geometry_msgs::Transform& t, double px, double py, double pz, double qx, double qy, double qz,
+                       double qw)
+{
+  t.translation.x = px;
+  t.translation.y = py;
+  t.translation.z = pz;
+  t.rotation.x = qx;
+  t.rotation.y = qy;
+  t.rotation.z = qz;
+  t.rotation.w = qw;
+}
+
+void link_transforms(const float thetas[7], const double lengths[2], geometry_msgs::Transform links[6])
+{
+  // Half angle sine and cosine of every joint
+  double s[7], c[7];
+  for (int i = 1; i < 7; i++)
+  {
+    s[i] = sin(0.5 * thetas[i]);
+    c[i] = cos(0.5 * thetas[i]);
+  }
+
+  // Rotation by a about an axis is (axis * sin(a/2), cos(a/2)); the pi
+  // offsets of the gimbal swap sine and cosine
+  set(links[0], 0, 0, 0, 0, 0, -s[1], c[1]); // Rz(-t1)
+  set(links[1], 0, 0, 0, 0, s[2], 0, c[2]); // Ry(t2)
+  set(links[2], -lengths[0], 0, 0, 0, s[3], 0, c[3]); // Ry(t3)
+  set(links[3], 0, 0, -lengths[1], c[4], 0, 0, -s[4]); // Rx(t4 + pi)
+  set(links[4], 0, 0, 0, 0, c[5], 0, s[5]); // Ry(-t5 + pi)
+  set(links[5], 0, 0, 0, 0, 0, c[6], -s[6]); // Rz(t6 + pi)
+}
+
+// sensable_origin axes in link_0: x = -y, y = z, z = -x. The transform
+// published from link_0 to sensable_origin, RPY(pi/2, 0, -pi/2).
+static inline void to_sensable(const double link[3], double sensable[3])
+{
+  sensable[0] = -link[1];
+  sensable[1] = link[2];
+  sensable[2] = -link[0];
+}
+
+// Link_0 -> link_3 applied to v: Rz(-joints[0]) Ry(joints[2])
+static void arm_rotate(const double joints[3], const double v[3], double out[3])
+{
+  const double c0 = cos(joints[0]), s0 = sin(joints[0]);
+  const double c2 = cos(joints[2]), s2 = sin(joints[2]);
+  double w[3] = {c2 * v[0] + s2 * v[2], v[1], -s2 * v[0] + c2 * v[2]};
+  out[0] = c0 * w[0] + s0 * w[1];
+  out[1] = -s0 * w[0] + c0 * w[1];
+  out[2] = w[2];
+}
+
+// Link_3 -> link_6 applied to v: Rx(rot[0]) Ry(rot[1]) Rz(rot[2])
+static void gimbal_rotate(const double rot[3], const double v[3], double out[3])
+{
+  const double c0 = cos(rot[0]), s0 = sin(rot[0]);
+  const double c1 = cos(rot[1]), s1 = sin(rot[1]);
+  const double c2 = cos(rot[2]), s2 = sin(rot[2]);
+  double z[3] = {c2 * v[0] - s2 * v[1], s2 * v[0] + c2 * v[1], v[2]};
+  double y[3] = {c1 * z[0] + s1 * z[2], z[1], -s1 * z[0] + c1 * z[2]};
+  out[0] = y[0];
+  out[1] = c0 * y[1] - s0 * y[2];
+  out[2] = s0 * y[1] + c0 * y[2];
+}
+
+void stylus_transform(const double joints[3], const double rot[3], const double position[3], double transform[16])
+{
+  // Column i is link_6 axis i
+  for (int i = 0; i < 3; i++)
+  {
+    double axis[3] = {0.0, 0.0, 0.0}, gimbal[3], arm[3];
+    axis[i] = 1.0;
+    gimbal_rotate(rot, axis, gimbal);
+    arm_rotate(joints, gimbal, arm);
+    to_sensable(arm, &transform[4 * i]);
+    transform[4 * i + 3] = 0.0;
+  }
+  transform[12] = position[0];
+  transform[13] = position[1];
+  transform[14] = position[2];
+  transform[15] = 1.0;
+}
+
+void gimbal_torques(const double joints[3], const double rot[3], const double torque[3], double gimbal_torque[3])
+{
+  const double c0 = cos(rot[0]), s0 = sin(rot[0]);
+  const double c1 = cos(rot[1]), s1 = sin(rot[1]);
+
+  // In link_3, the axes are x, Rx(rot[0]) y and Rx(rot[0]) Ry(rot[1]) z
+  const double axes[3][3] = {{1.0, 0.0, 0.0}, {0.0, c0, s0}, {s1, -s0 * c1, c0 * c1}};
+
+  for (int j = 0; j < 3; j++)
+  {
+    double link[3], axis[3];
+    arm_rotate(joints, axes[j], link);
+    to_sensable(link, axis);
+    gimbal_torque[j] = axis[0] * torque[0] + axis[1] * torque[1] + axis[2] * torque[2];
+  }
+}
+
+} // namespace sensable_phantom
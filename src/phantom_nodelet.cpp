@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <nodelet/nodelet.h>
+#include <pluginlib/class_list_macros.h>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "sensable_phantom/phantom_driver.h"
+
+namespace sensable_phantom
+{
+
+/*
+ * Same driver as phantom_node, loaded into a nodelet manager. Messages are
+ * published as shared pointers, so subscribers in the same manager (e.g. a
+ * teleoperation controller) receive them without serialization.
+ */
+class PhantomNodelet : public nodelet::Nodelet
+{
+public:
+  ~PhantomNodelet()
+  {
+    if (driver_)
+      driver_->stop();
+  }
+
+private:
+  void onInit()
+  {
+    driver_.reset(new PhantomDriver);
+    // Multi-threaded handle, so that force feedback is not serialized behind
+    // the diagnostics timer; wrench_callback is thread-safe.
+    if (driver_->init(getMTNodeHandle(), getMTPrivateNodeHandle()) || driver_->start())
+    {
+      NODELET_FATAL("Failed to start the PHANToM driver");
+      driver_.reset();
+    }
+  }
+
+  boost::scoped_ptr<PhantomDriver> driver_;
+};
+
+} // namespace sensable_phantom
+
+PLUGINLIB_EXPORT_CLASS(sensable_phantom::PhantomNodelet, nodelet::Nodelet)
@@ -0,0 +1,1032 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+#include <geometry_msgs/PoseStamped.h>
+#include <geometry_msgs/Vector3Stamped.h>
+#include <tf/transform_datatypes.h>
+
+#include <string.h>
+#include <math.h>
+#include <sstream>
+
+#include "sensable_phantom/PhantomButtonEvent.h"
+#include "sensable_phantom/phantom_kinematics.h"
+#include "sensable_phantom/phantom_ros.h"
+
+namespace sensable_phantom
+{
+
+const double PhantomROS::DEFAULT_DAMPING_K = 0.001;
+
+PhantomROS::PhantomROS() :
+    pool_overflows_(0), table_offset_(0.0), damping_k_(0.0), locked_(false), calibrate_(false), publish_rate_(100),
+    event_driven_(false), batch_size_(0), publish_links_(false), state_(NULL), listener_(new tf::TransformListener), ls_(*listener_),
+    wrench_frames_(ls_), log_dropped_(0), button_dropped_(0), batch_dropped_(0), running_(false)
+{
+}
+
+PhantomROS::PhantomROS(const tf::Transformer& transformer) :
+    pool_overflows_(0), table_offset_(0.0), damping_k_(0.0), locked_(false), calibrate_(false), publish_rate_(100),
+    event_driven_(false), batch_size_(0), publish_links_(false), state_(NULL), ls_(transformer),
+    wrench_frames_(ls_), log_dropped_(0), button_dropped_(0), batch_dropped_(0), running_(false)
+{
+}
+
+PhantomROS::~PhantomROS()
+{
+  stop();
+  if (state_)
+  {
+    state_->log_queue = NULL;
+    delete state_->mesh.exchange(NULL);
+  }
+  flight_log_.reset();
+  for (size_t i = 0; i < mesh_retired_.size(); i++)
+    delete mesh_retired_[i];
+}
+
+int PhantomROS::init(PhantomState *s, const ros::NodeHandle& node, const ros::NodeHandle& pnode)
+{
+  if(!s)
+  {
+    ROS_FATAL("Internal error. PhantomState is NULL.");
+    return -1;
+  }
+
+  node_ = ros::NodeHandlePtr(new ros::NodeHandle(node));
+  pnode_ = ros::NodeHandlePtr(new ros::NodeHandle(pnode));
+  pnode_->param(std::string("tf_prefix"), tf_prefix_, std::string(""));
+
+  // Vertical displacement from base_link to link_0. Defaults to Omni offset.
+  pnode_->param(std::string("table_offset"), table_offset_, .135);
+
+  // Force feedback damping coefficient, N/(mm/s) as it always was; the
+  // velocity it multiplies is in mm/s
+  pnode_->param(std::string("damping_k"), damping_k_, DEFAULT_DAMPING_K);
+
+  // On startup device will generate forces to hold end-effector where it is.
+  pnode_->param(std::string("locked"), locked_, false);
+
+  // Lock controller gains, SI units; updated at run time on NAME/lock_gains
+  LockGainsUpdate lock_gains;
+  pnode_->param(std::string("lock_stiffness"), lock_gains.stiffness, 40.0);
+  pnode_->param(std::string("lock_damping"), lock_gains.damping, 1.0);
+  pnode_->param(std::string("lock_max_force"), lock_gains.max_force, 3.0);
+  pnode_->param(std::string("lock_ramp_time"), lock_gains.ramp_time, 0.5);
+
+  // Check calibration status on start up and calibrate if necessary.
+  pnode_->param(std::string("calibrate"), calibrate_, false);
+
+  // reading param from private namespace
+  pnode_->param(std::string("publish_rate"), publish_rate_, 100);
+  if (publish_rate_ <= 0)
+  {
+    ROS_FATAL("publish_rate must be positive");
+    return -1;
+  }
+
+  // "rate": publisher polls the latest state at publish_rate
+  // "event": servo loop hands every N-th sample over to the publisher, N = servo rate / publish_rate
+  std::string publish_mode;
+  pnode_->param(std::string("publish_mode"), publish_mode, std::string("rate"));
+  if (publish_mode != "rate" && publish_mode != "event")
+  {
+    ROS_FATAL("Unknown publish_mode '%s'", publish_mode.c_str());
+    return -1;
+  }
+  event_driven_ = (publish_mode == "event");
+
+  // Number of consecutive servo samples per message on NAME/samples; 0 disables the stream
+  pnode_->param(std::string("batch_size"), batch_size_, 0);
+
+  // "filter": backward difference + Butterworth low-pass, velocity only
+  // "kalman": constant-acceleration Kalman estimator, velocity and acceleration
+  std::string velocity_estimator;
+  pnode_->param(std::string("velocity_estimator"), velocity_estimator, std::string("filter"));
+  if (velocity_estimator != "filter" && velocity_estimator != "kalman")
+  {
+    ROS_FATAL("Unknown velocity_estimator '%s'", velocity_estimator.c_str());
+    return -1;
+  }
+
+  // Kalman tuning: white jerk spectral density, mm^2/s^5, and position noise std, mm
+  double kalman_jerk_psd, kalman_position_sigma;
+  pnode_->param(std::string("kalman_jerk_psd"), kalman_jerk_psd, 4e9);
+  pnode_->param(std::string("kalman_position_sigma"), kalman_position_sigma, 0.03);
+
+  // Velocity low-pass: Butterworth order and cutoff, Hz
+  int velocity_filter_order;
+  pnode_->param(std::string("velocity_filter_order"), velocity_filter_order, 3);
+  double velocity_cutoff;
+  pnode_->param(std::string("velocity_cutoff"), velocity_cutoff, 20.0);
+
+  // UDP port for the low-latency force path (see command_socket.h); 0 disables it.
+  // Packets are not authenticated, so only the local host may send by default.
+  int command_port;
+  pnode_->param(std::string("command_port"), command_port, 0);
+  std::string command_address;
+  pnode_->param(std::string("command_address"), command_address, std::string("127.0.0.1"));
+  // Remote forces older than this are zeroed, s
+  double command_timeout;
+  pnode_->param(std::string("command_timeout"), command_timeout, 0.005);
+  // Largest remote force applied, N
+  double command_max_force;
+  pnode_->param(std::string("command_max_force"), command_max_force, 3.0);
+
+  // Binary log of every servo tick (see flight_log.h); empty disables it.
+  // Preallocated for log_duration seconds, grows past that.
+  std::string log_file;
+  pnode_->param(std::string("log_file"), log_file, std::string(""));
+  double log_duration;
+  pnode_->param(std::string("log_duration"), log_duration, 3600.0);
+
+  // Servo timing report period, s
+  double diagnostics_period;
+  pnode_->param(std::string("diagnostics_period"), diagnostics_period, 1.0);
+
+  // Servo tick longer than (1 + overrun_tolerance) nominal periods is an overrun
+  double overrun_tolerance;
+  pnode_->param(std::string("overrun_tolerance"), overrun_tolerance, 0.1);
+
+  // Publish link_1..link_6 from forward kinematics. Arm lengths are known for
+  // the Omni and the Premium 1.5 and 3.0; other models need link_lengths.
+  pnode_->param(std::string("publish_links"), publish_links_, true);
+  std::vector<double> link_lengths;
+  if (pnode_->getParam(std::string("link_lengths"), link_lengths))
+  {
+    if (link_lengths.size() != 2 || link_lengths[0] <= 0.0 || link_lengths[1] <= 0.0)
+    {
+      ROS_FATAL("link_lengths must be two positive lengths in m, upper and lower arm");
+      return -1;
+    }
+    link_lengths_[0] = link_lengths[0];
+    link_lengths_[1] = link_lengths[1];
+  }
+  else if (publish_links_ && default_link_lengths(s->device->model(), link_lengths_))
+  {
+    ROS_WARN("No link lengths known for '%s', set ~link_lengths to publish links", s->device->model().c_str());
+    publish_links_ = false;
+  }
+
+  //Frame attached to the base of the phantom (NAME/base_link)
+  base_link_name_ = "base_link";
+
+  //Frame of force feedback (NAME/sensable_origin)
+  sensable_frame_name_ = "sensable_origin";
+
+  for (int i = 0; i < 7; i++)
+  {
+    std::ostringstream stream1;
+    stream1 << "link_" << i;
+    link_names_[i] = std::string(stream1.str());
+  }
+
+  // Resolved once; the publish path never builds frame id strings
+  base_frame_id_ = tf::resolve(tf_prefix_, base_link_name_);
+  sensable_frame_id_ = tf::resolve(tf_prefix_, sensable_frame_name_);
+  for (int i = 0; i < 7; i++)
+    link_frame_ids_[i] = tf::resolve(tf_prefix_, link_names_[i]);
+
+  //Publish on NAME/pose
+  std::string pose_topic_name = "pose";
+  pose_publisher_ = node_->advertise<geometry_msgs::PoseStamped>(pose_topic_name, 100);
+  geometry_msgs::PoseStamped pose_prototype;
+  pose_prototype.header.frame_id = link_frame_ids_[0];
+  pose_pool_.init(MESSAGE_POOL_SIZE, pose_prototype, MESSAGE_POOL_MAX_SIZE);
+
+  //Publish stylus velocity on NAME/velocity, and acceleration on NAME/acceleration when estimated
+  velocity_publisher_ = node_->advertise<geometry_msgs::Vector3Stamped>("velocity", 100);
+  geometry_msgs::Vector3Stamped vector_prototype;
+  vector_prototype.header.frame_id = sensable_frame_id_;
+  velocity_pool_.init(MESSAGE_POOL_SIZE, vector_prototype, MESSAGE_POOL_MAX_SIZE);
+  if (velocity_estimator == "kalman")
+  {
+    acceleration_publisher_ = node_->advertise<geometry_msgs::Vector3Stamped>("acceleration", 100);
+    acceleration_pool_.init(MESSAGE_POOL_SIZE, vector_prototype, MESSAGE_POOL_MAX_SIZE);
+  }
+
+  //Publish joint angles and rates on NAME/joint_states, joint_i moves link_i
+  joint_state_publisher_ = node_->advertise<sensor_msgs::JointState>("joint_states", 100);
+  sensor_msgs::JointState joint_state_prototype;
+  joint_state_prototype.name.resize(6);
+  joint_state_prototype.position.resize(6);
+  joint_state_prototype.velocity.resize(6);
+  for (int i = 0; i < 6; i++)
+  {
+    std::ostringstream stream;
+    stream << "joint_" << i + 1;
+    joint_state_prototype.name[i] = stream.str();
+  }
+  joint_state_pool_.init(MESSAGE_POOL_SIZE, joint_state_prototype, MESSAGE_POOL_MAX_SIZE);
+
+  //Publish link_1..link_6 on /tf, one message for the whole chain
+  if (publish_links_)
+  {
+    link_publisher_ = node_->advertise<tf2_msgs::TFMessage>("/tf", 100);
+    tf2_msgs::TFMessage link_prototype;
+    link_prototype.transforms.resize(6);
+    for (int i = 1; i < 7; i++)
+    {
+      link_prototype.transforms[i - 1].header.frame_id = link_frame_ids_[i - 1];
+      link_prototype.transforms[i - 1].child_frame_id = link_frame_ids_[i];
+    }
+    link_pool_.init(MESSAGE_POOL_SIZE, link_prototype, MESSAGE_POOL_MAX_SIZE);
+  }
+
+  //Publish button state on NAME/button
+  std::string button_topic = "button";
+  button_publisher_ = node_->advertise<PhantomButtonEvent>(button_topic, 100);
+  button_pool_.init(MESSAGE_POOL_SIZE, PhantomButtonEvent(), MESSAGE_POOL_MAX_SIZE);
+
+  //Publish every servo sample, batched, on NAME/samples
+  if (batch_size_ > 0)
+  {
+    batch_publisher_ = node_->advertise<ServoSampleBatch>("samples", 10);
+    ServoSampleBatch batch_prototype;
+    batch_prototype.header.frame_id = link_frame_ids_[0];
+    batch_pool_.init(MESSAGE_POOL_SIZE, batch_prototype, MESSAGE_POOL_MAX_SIZE);
+    batch_ = batch_pool_.acquire();
+    batch_->samples.reserve(batch_size_);
+  }
+
+  //Publish servo timing on /diagnostics
+  diagnostics_publisher_ = node_->advertise<diagnostic_msgs::DiagnosticArray>("/diagnostics", 10);
+
+  // Construct transforms. They never change, so they go to /tf_static once.
+  tf::Transform l0;
+  // Distance from table top to first intersection of the axes
+  l0.setOrigin(tf::Vector3(0, 0, table_offset_)); // .135 - Omni, .155 - Premium 1.5, .345 - Premium 3.0
+  l0.setRotation(tf::createQuaternionFromRPY(0, 0, 0));
+
+  // Displacement from vertical axis towards user.
+  // Frame in which OpenHaptics report Phantom coordinates. Valid and useful
+  // for Omni only, since other devices do not do calibration.
+  sensable_transform_.setOrigin(tf::Vector3(-0.2, 0, 0));
+  sensable_transform_.setRotation(tf::createQuaternionFromRPY(M_PI / 2, 0, -M_PI / 2));
+
+  // Static broadcaster does not apply tf_prefix by itself
+  ros::Time now = ros::Time::now();
+  std::vector<geometry_msgs::TransformStamped> static_transforms(2);
+  tf::transformStampedTFToMsg(
+      tf::StampedTransform(l0, now, base_frame_id_, link_frame_ids_[0]),
+      static_transforms[0]);
+  tf::transformStampedTFToMsg(
+      tf::StampedTransform(sensable_transform_, now, link_frame_ids_[0], sensable_frame_id_),
+      static_transforms[1]);
+  static_br_.reset(new tf2_ros::StaticTransformBroadcaster);
+  static_br_->sendTransform(static_transforms);
+
+  // Rotations from these frames into sensable_origin are looked up once.
+  // Our own base_link -> link_0 -> sensable_origin chain never moves; users
+  // may add frames they know to be rigidly attached to it.
+  std::vector<std::string> static_frames;
+  pnode_->getParam(std::string("static_frames"), static_frames);
+  static_frames.push_back(base_link_name_);
+  static_frames.push_back(link_names_[0]);
+  wrench_frames_.set_target_frame(sensable_frame_id_);
+  wrench_frames_.add_static_frame(sensable_frame_id_);
+  for (size_t i = 0; i < static_frames.size(); i++)
+  {
+    wrench_frames_.add_static_frame(static_frames[i]);
+    wrench_frames_.add_static_frame(tf::resolve(tf_prefix_, static_frames[i]));
+  }
+
+  state_ = s;
+  state_->stats.configure(state_->servo_rate, overrun_tolerance);
+  // The servo callback is not scheduled yet, so the filter can be set up in place
+  if (state_->velocity_filter.configure(velocity_filter_order, velocity_cutoff, state_->servo_rate))
+  {
+    ROS_FATAL("Invalid velocity filter: order %d (1..%d), cutoff %g Hz at %g Hz servo rate", velocity_filter_order,
+              VelocityFilter::MAX_ORDER, velocity_cutoff, state_->servo_rate);
+    return -1;
+  }
+  // Joint rates get the same low-pass as the stylus velocity
+  state_->joint_filter.configure(velocity_filter_order, velocity_cutoff, state_->servo_rate);
+  state_->gimbal_filter.configure(velocity_filter_order, velocity_cutoff, state_->servo_rate);
+  state_->kalman_enabled = (velocity_estimator == "kalman");
+  if (state_->kalman_enabled)
+  {
+    if (state_->kalman.configure(state_->servo_rate, kalman_jerk_psd, kalman_position_sigma))
+    {
+      ROS_FATAL("kalman_jerk_psd and kalman_position_sigma must be positive");
+      return -1;
+    }
+    ROS_INFO("Velocity estimator: Kalman, jerk PSD %g mm^2/s^5, position sigma %g mm", kalman_jerk_psd,
+             kalman_position_sigma);
+  }
+  else
+  {
+    ROS_INFO("Velocity filter: order %d Butterworth, %g Hz cutoff at %g Hz", velocity_filter_order, velocity_cutoff,
+             state_->servo_rate);
+  }
+  if (event_driven_)
+  {
+    if (!state_->publish_event.valid())
+    {
+      ROS_FATAL("Failed to create publisher eventfd");
+      return -1;
+    }
+    long decimation = lround(state_->servo_rate / publish_rate_);
+    state_->publish_decimation = decimation > 1 ? decimation : 1;
+    ROS_INFO("Publishing every %u servo ticks", state_->publish_decimation);
+  }
+  state_->batch_enabled = (batch_size_ > 0);
+  state_->gimbal_torque_enabled = state_->device->has_gimbal_torque();
+  if (state_->gimbal_torque_enabled)
+    ROS_INFO("Torque is applied about the gimbal axes");
+  if (!log_file.empty())
+  {
+    flight_log_.reset(new FlightLogger);
+    if (flight_log_->open(log_file, log_duration, state_->servo_rate, pnode_->getNamespace(), state_->device->model()))
+      return -1;
+    flight_log_->start();
+    state_->log_queue = &flight_log_->queue();
+  }
+  if (pnode_->hasParam("force_fields"))
+  {
+    force_fields_.reset(new ForceFieldChain);
+    if (force_fields_->load(*pnode_))
+      return -1;
+    if (!force_fields_->empty())
+      state_->force_fields = force_fields_.get();
+  }
+
+  if (command_port > 0)
+  {
+    if (command_max_force <= 0.0)
+    {
+      ROS_FATAL("command_max_force must be positive");
+      return -1;
+    }
+    state_->command_timeout_ns = (int64_t)(command_timeout * 1e9);
+    if (command_socket_.open(command_address, command_port, state_->command_timeout_ns))
+      return -1;
+    state_->command_max_force = command_max_force;
+    state_->command_damping = damping_k_;
+    state_->command_socket = &command_socket_;
+    ROS_INFO("Force commands on udp://%s:%d, timeout %.1f ms, at most %g N", command_address.c_str(), command_port,
+             command_timeout * 1000.0, command_max_force);
+  }
+  memset(&period_prev_, 0, sizeof(period_prev_));
+  memset(&execution_prev_, 0, sizeof(execution_prev_));
+  memset(&overrun_prev_, 0, sizeof(overrun_prev_));
+
+  PhantomSample sample;
+  memset(&sample, 0, sizeof(sample));
+  for (int i = 0; i < 4; i++)
+    sample.transform[i * 5] = 1.0;
+  state_->sample.store(sample);
+
+  memset(&command_, 0, sizeof(command_));
+  state_->command.write(command_);
+  state_->lock = locked_;
+  if (set_lock_gains(lock_gains))
+    return -1;
+  running_ = true;
+  mesh_thread_ = boost::thread(&PhantomROS::mesh_loop, this);
+
+  // Callbacks may fire right away, so these come last
+  diagnostics_timer_ = node_->createTimer(ros::Duration(diagnostics_period), &PhantomROS::diagnostics_callback, this);
+
+  //Subscribe to NAME/force_feedback, unless forces come over the socket
+  if (!command_socket_.valid())
+  {
+    std::string force_feedback_topic = "force_feedback";
+    wrench_sub_ = node_->subscribe(force_feedback_topic, 100, &PhantomROS::wrench_callback, this);
+  }
+
+  //Subscribe to NAME/haptic_scene, rendered locally by the servo loop
+  scene_sub_ = node_->subscribe("haptic_scene", 1, &PhantomROS::scene_callback, this);
+
+  //Subscribe to NAME/haptic_mesh, rendered with a proxy by the servo loop
+  mesh_sub_ = node_->subscribe("haptic_mesh", 1, &PhantomROS::mesh_callback, this);
+
+  //Subscribe to NAME/lock_gains to tune the lock controller
+  lock_gains_sub_ = node_->subscribe("lock_gains", 1, &PhantomROS::lock_gains_callback, this);
+
+  //Subscribe to NAME/force_field_parameters when there are plugins to tune
+  if (state_->force_fields)
+    force_field_sub_ = node_->subscribe("force_field_parameters", 10, &PhantomROS::force_field_callback, this);
+
+  return 0;
+}
+
+/*******************************************************************************
+ ROS node callback.
+ *******************************************************************************/
+void PhantomROS::wrench_callback(const geometry_msgs::WrenchStampedConstPtr& wrench)
+{
+  // Both force and torque supplied in the same coordinate frame
+  tf::Vector3 f_out, t_out;
+  tf::vector3MsgToTF(wrench->wrench.force, f_out);
+  tf::vector3MsgToTF(wrench->wrench.torque, t_out);
+
+  try
+  {
+    wrench_frames_.rotate(wrench->header.frame_id, f_out, t_out);
+  }
+  catch(tf::TransformException& ex)
+  {
+    ROS_ERROR("%s", ex.what());
+    f_out.setValue(0, 0, 0);
+    t_out.setValue(0, 0, 0);
+  }
+
+  PhantomSample sample;
+  state_->sample.load(sample);
+
+  boost::mutex::scoped_lock lock(command_mutex_);
+  ////////////////////Some people might not like this extra damping, but it
+  ////////////////////helps to stabilize the overall force feedback. It isn't
+  ////////////////////like we are getting direct impedance matching from the
+  ////////////////////omni anyway
+  command_.force[0] = f_out.x() - damping_k_ * sample.velocity[0];
+  command_.force[1] = f_out.y() - damping_k_ * sample.velocity[1];
+  command_.force[2] = f_out.z() - damping_k_ * sample.velocity[2];
+
+  // Mapped onto the gimbal axes by the servo loop on 6-DoF devices
+  command_.torque[0] = t_out.x();
+  command_.torque[1] = t_out.y();
+  command_.torque[2] = t_out.z();
+  state_->command.write(command_);
+}
+
+/*******************************************************************************
+ Converts a scene to device units and hands it over to the servo loop.
+ *******************************************************************************/
+void PhantomROS::scene_callback(const HapticSceneConstPtr& scene)
+{
+  if ((int)scene->primitives.size() > PrimitiveScene::MAX_PRIMITIVES)
+  {
+    ROS_ERROR("Haptic scene has %zu primitives, at most %d are supported", scene->primitives.size(),
+              PrimitiveScene::MAX_PRIMITIVES);
+    return;
+  }
+
+  // Primitives are rendered in sensable_origin
+  tf::StampedTransform frame;
+  frame.setIdentity();
+  if (!scene->header.frame_id.empty())
+  {
+    try
+    {
+      ls_.lookupTransform(sensable_frame_id_, scene->header.frame_id, ros::Time(0), frame);
+    }
+    catch(tf::TransformException& ex)
+    {
+      ROS_ERROR("%s", ex.what());
+      return;
+    }
+  }
+
+  // Single producer: only this callback writes the scene
+  PrimitiveScene& out = state_->scene.write_slot();
+  out.count = 0;
+  for (size_t k = 0; k < scene->primitives.size(); k++)
+  {
+    const HapticPrimitive& in = scene->primitives[k];
+    ScenePrimitive& p = out.primitives[out.count];
+    if (in.stiffness < 0.0 || in.damping < 0.0 || in.size.x < 0.0 || in.size.y < 0.0 || in.size.z < 0.0)
+    {
+      ROS_ERROR("Haptic primitive %zu has negative size or gains, scene ignored", k);
+      return;
+    }
+
+    tf::Transform pose;
+    tf::poseMsgToTF(in.pose, pose);
+    pose = frame * pose;
+    const tf::Matrix3x3& basis = pose.getBasis();
+    for (int i = 0; i < 3; i++)
+    {
+      // mm in the device
+      p.center[i] = pose.getOrigin()[i] * 1000.0;
+      for (int j = 0; j < 3; j++)
+        p.axes[i][j] = basis[j][i];
+    }
+
+    switch (in.type)
+    {
+      case HapticPrimitive::PLANE:
+        p.type = ScenePrimitive::PLANE;
+        // Outward normal is the z axis of the pose
+        for (int j = 0; j < 3; j++)
+          p.axes[0][j] = basis[j][2];
+        break;
+      case HapticPrimitive::SPHERE:
+        p.type = ScenePrimitive::SPHERE;
+        p.size[0] = in.size.x * 1000.0;
+        break;
+      case HapticPrimitive::BOX:
+        p.type = ScenePrimitive::BOX;
+        p.size[0] = in.size.x * 500.0;
+        p.size[1] = in.size.y * 500.0;
+        p.size[2] = in.size.z * 500.0;
+        break;
+      default:
+        ROS_ERROR("Haptic primitive %zu has unknown type %d, scene ignored", k, in.type);
+        return;
+    }
+
+    // Per meter -> per millimeter
+    p.stiffness = in.stiffness / 1000.0;
+    p.damping = in.damping / 1000.0;
+    out.count++;
+  }
+  state_->scene.publish();
+}
+
+/*******************************************************************************
+ Resolves the mesh pose now and leaves loading to the mesh thread.
+ *******************************************************************************/
+void PhantomROS::mesh_callback(const HapticMeshConstPtr& mesh)
+{
+  tf::StampedTransform frame;
+  frame.setIdentity();
+  if (!mesh->header.frame_id.empty())
+  {
+    try
+    {
+      ls_.lookupTransform(sensable_frame_id_, mesh->header.frame_id, ros::Time(0), frame);
+    }
+    catch(tf::TransformException& ex)
+    {
+      ROS_ERROR("%s", ex.what());
+      return;
+    }
+  }
+
+  tf::Transform pose;
+  tf::poseMsgToTF(mesh->pose, pose);
+
+  boost::mutex::scoped_lock lock(mesh_mutex_);
+  mesh_request_ = mesh;
+  mesh_transform_ = frame * pose;
+  mesh_condition_.notify_one();
+}
+
+void PhantomROS::mesh_loop()
+{
+  while (running_)
+  {
+    HapticMeshConstPtr request;
+    tf::Transform transform;
+    {
+      boost::mutex::scoped_lock lock(mesh_mutex_);
+      while (running_ && !mesh_request_)
+        mesh_condition_.wait(lock);
+      if (!running_)
+        break;
+      request.swap(mesh_request_);
+      transform = mesh_transform_;
+    }
+
+    // A malformed file or one too big to fit in memory drops the request and
+    // keeps the current mesh rather than taking the driver down
+    MeshModel *model = NULL;
+    if (!request->filename.empty())
+    {
+      try
+      {
+        TriangleMesh mesh;
+        if (load_mesh(request->filename, mesh))
+          continue;
+
+        // To sensable_origin, mm
+        double scale = request->scale > 0.0 ? request->scale : 1.0;
+        for (size_t i = 0; i < mesh.vertices.size(); i += 3)
+        {
+          tf::Vector3 v(mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2]);
+          v = transform * (v * scale);
+          mesh.vertices[i] = v.x() * 1000.0;
+          mesh.vertices[i + 1] = v.y() * 1000.0;
+          mesh.vertices[i + 2] = v.z() * 1000.0;
+        }
+
+        ros::WallTime start = ros::WallTime::now();
+        model = new MeshModel(mesh, request->stiffness / 1000.0, request->damping / 1000.0);
+        ROS_INFO("Loaded %s: %zu triangles, hierarchy built in %.0f ms", request->filename.c_str(), model->triangles(),
+                 (ros::WallTime::now() - start).toSec() * 1000.0);
+      }
+      catch (const std::exception& e)
+      {
+        ROS_ERROR("Failed to load mesh %s: %s", request->filename.c_str(), e.what());
+        continue;
+      }
+    }
+
+    // Swap the new model in and free the old one once the servo loop is off it
+    const MeshModel *old = state_->mesh.exchange(model);
+    if (old)
+      mesh_retired_.push_back(old);
+    while (running_ && old && state_->mesh_hazard.load() == old)
+      boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+    for (size_t i = 0; i < mesh_retired_.size();)
+    {
+      if (state_->mesh_hazard.load() != mesh_retired_[i])
+      {
+        delete mesh_retired_[i];
+        mesh_retired_[i] = mesh_retired_.back();
+        mesh_retired_.pop_back();
+      }
+      else
+        i++;
+    }
+  }
+}
+
+void PhantomROS::force_field_callback(const ForceFieldUpdateConstPtr& update)
+{
+  force_fields_->set_parameters(update->field, update->names, update->values);
+}
+
+void PhantomROS::lock_gains_callback(const LockGainsUpdateConstPtr& update)
+{
+  set_lock_gains(*update);
+}
+
+int PhantomROS::set_lock_gains(const LockGainsUpdate& update)
+{
+  if (!(update.stiffness >= 0.0 && update.damping >= 0.0 && update.max_force >= 0.0 && update.ramp_time >= 0.0))
+  {
+    ROS_ERROR("Lock gains must not be negative, ignored");
+    return -1;
+  }
+
+  // Servo loop works in mm; single producer: init(), then only this callback
+  LockGains& gains = state_->lock_gains.write_slot();
+  gains.stiffness = update.stiffness / 1000.0;
+  gains.damping = update.damping / 1000.0;
+  gains.max_force = update.max_force;
+  gains.ramp_time = update.ramp_time;
+  state_->lock_gains.publish();
+  ROS_INFO("Lock gains: %g N/m, %g Ns/m, at most %g N, %g s ramp", update.stiffness, update.damping, update.max_force,
+           update.ramp_time);
+  return 0;
+}
+
+/*******************************************************************************
+ Servo loop timing report. Percentiles are over the last report interval.
+ *******************************************************************************/
+void PhantomROS::diagnostics_callback(const ros::TimerEvent&)
+{
+  HistogramSnapshot period, execution, overrun;
+  state_->stats.period().snapshot(period);
+  state_->stats.execution().snapshot(execution);
+  state_->stats.overrun().snapshot(overrun);
+  uint64_t total_overruns = overrun.total();
+
+  interval(period, period_prev_);
+  interval(execution, execution_prev_);
+  interval(overrun, overrun_prev_);
+
+  diagnostic_msgs::DiagnosticStatus status;
+  status.name = pnode_->getNamespace() + ": servo loop";
+  status.hardware_id = state_->device->model();
+
+  uint64_t ticks = period.total();
+  uint64_t overruns = overrun.total();
+  double period_ns = state_->stats.period_ns();
+  if (ticks == 0)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+    status.message = "Servo loop is not running";
+  }
+  else if (execution.percentile(0.999) > period_ns)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::ERROR;
+    status.message = "Servo callback exceeds its period";
+  }
+  else if (overruns > 0)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Servo deadline overruns";
+  }
+  else
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    status.message = "OK";
+  }
+
+  add_value(status, "Ticks", ticks);
+  add_value(status, "Rate (Hz)", ticks ? 1e9 / period.mean() : 0.0);
+  add_value(status, "Nominal period (us)", period_ns / 1000.0);
+  add_latency(status, "Period", period);
+  add_latency(status, "Execution", execution);
+  add_value(status, "Overruns", overruns);
+  add_value(status, "Overruns total", total_overruns);
+  add_value(status, "Overrun max lateness (us)", overrun.max() / 1000.0);
+  if (command_socket_.valid())
+  {
+    add_value(status, "Remote commands total", state_->remote_received.load(std::memory_order_relaxed));
+    add_value(status, "Remote commands rejected", command_socket_.rejected());
+    add_value(status, "Remote stale ticks total", state_->remote_stale.load(std::memory_order_relaxed));
+  }
+
+  if (flight_log_)
+  {
+    unsigned long dropped = state_->log_dropped.load(std::memory_order_relaxed);
+    if ((dropped != log_dropped_ || flight_log_->failed()) && status.level == diagnostic_msgs::DiagnosticStatus::OK)
+    {
+      status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+      status.message = flight_log_->failed() ? "Flight log is full" : "Flight log dropped records";
+    }
+    add_value(status, "Flight log records", flight_log_->written());
+    add_value(status, "Flight log dropped", dropped - log_dropped_);
+    add_value(status, "Flight log dropped total", dropped);
+    log_dropped_ = dropped;
+  }
+
+  // Pools past their cap mean a subscriber holds on to every message
+  unsigned long pool_misses = pose_pool_.misses() + velocity_pool_.misses() + acceleration_pool_.misses() +
+                              joint_state_pool_.misses() + link_pool_.misses() + button_pool_.misses() +
+                              batch_pool_.misses();
+  unsigned long pool_overflows = pose_pool_.overflows() + velocity_pool_.overflows() +
+                                 acceleration_pool_.overflows() + joint_state_pool_.overflows() +
+                                 link_pool_.overflows() + button_pool_.overflows() + batch_pool_.overflows();
+  if (pool_overflows != pool_overflows_ && status.level == diagnostic_msgs::DiagnosticStatus::OK)
+  {
+    status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+    status.message = "Message pools full, publishing allocates";
+  }
+  add_value(status, "Message pool allocations total", pool_misses);
+  add_value(status, "Message pool overflows", pool_overflows - pool_overflows_);
+  add_value(status, "Message pool overflows total", pool_overflows);
+  pool_overflows_ = pool_overflows;
+
+  diagnostic_msgs::DiagnosticArray diagnostics;
+  diagnostics.header.stamp = ros::Time::now();
+  diagnostics.status.push_back(status);
+
+  if (state_->force_fields)
+  {
+    std::vector<ForceFieldChain::Status> fields;
+    force_fields_->status(fields);
+    force_fields_enabled_.resize(fields.size(), 1);
+
+    diagnostic_msgs::DiagnosticStatus field_status;
+    field_status.name = pnode_->getNamespace() + ": force fields";
+    field_status.hardware_id = status.hardware_id;
+    field_status.level = diagnostic_msgs::DiagnosticStatus::OK;
+    field_status.message = "OK";
+    for (size_t i = 0; i < fields.size(); i++)
+    {
+      const ForceFieldChain::Status& field = fields[i];
+      if (!field.enabled)
+      {
+        if (force_fields_enabled_[i])
+          ROS_WARN("Force field %s exceeded its %.0f us budget and was disabled", field.name.c_str(),
+                   field.budget_ns / 1000.0);
+        field_status.level = diagnostic_msgs::DiagnosticStatus::WARN;
+        field_status.message = "Force field disabled for exceeding its budget";
+      }
+      force_fields_enabled_[i] = field.enabled;
+
+      add_value(field_status, field.name + " enabled", field.enabled ? "true" : "false");
+      add_value(field_status, field.name + " budget (us)", field.budget_ns / 1000.0);
+      add_value(field_status, field.name + " overruns total", field.overruns);
+      add_value(field_status, field.name + " execution p99 (us)", field.execution.percentile(0.99) / 1000.0);
+      add_value(field_status, field.name + " execution max (us)", field.execution.max() / 1000.0);
+    }
+    diagnostics.status.push_back(field_status);
+  }
+  diagnostics_publisher_.publish(diagnostics);
+}
+
+// Turns a cumulative snapshot into the interval since prev, and keeps the
+// cumulative one in prev for the next round
+void PhantomROS::interval(HistogramSnapshot& h, HistogramSnapshot& prev)
+{
+  HistogramSnapshot cumulative = h;
+  h.subtract(prev);
+  prev = cumulative;
+}
+
+template <typename T>
+void PhantomROS::add_value(diagnostic_msgs::DiagnosticStatus& status, const std::string& key, T value)
+{
+  std::ostringstream stream;
+  stream << value;
+  diagnostic_msgs::KeyValue kv;
+  kv.key = key;
+  kv.value = stream.str();
+  status.values.push_back(kv);
+}
+
+void PhantomROS::add_latency(diagnostic_msgs::DiagnosticStatus& status, const std::string& name,
+                             const HistogramSnapshot& h)
+{
+  add_value(status, name + " p50 (us)", h.percentile(0.5) / 1000.0);
+  add_value(status, name + " p99 (us)", h.percentile(0.99) / 1000.0);
+  add_value(status, name + " p99.9 (us)", h.percentile(0.999) / 1000.0);
+  add_value(status, name + " max (us)", h.max() / 1000.0);
+}
+
+void PhantomROS::publish_phantom_state()
+{
+  PhantomSample sample;
+  state_->sample.load(sample);
+  publish_sample(sample);
+}
+
+void PhantomROS::publish_sample(const PhantomSample& sample)
+{
+  // One timestamp for everything published in this cycle: when the device was read
+  ros::Time now = ros::Time::now() - ros::Duration((monotonic_ns() - sample.stamp_ns) * 1e-9);
+  if (sample.error)
+    ROS_ERROR_THROTTLE(1.0, "Device error 0x%04x at tick %lu", sample.error, sample.tick);
+
+  // Messages come from the pools with their frame ids already set; they are
+  // published as shared_ptr so that nodelets in the same process get them
+  // without serialization
+  geometry_msgs::PoseStampedPtr phantom_pose = pose_pool_.acquire();
+
+  // Publish pose in link_0
+  phantom_pose->header.stamp = now;
+  sample_pose(sample, phantom_pose->pose);
+  pose_publisher_.publish(phantom_pose);
+
+  // Velocity and acceleration in sensable_origin, m/s and m/s^2
+  geometry_msgs::Vector3StampedPtr velocity = velocity_pool_.acquire();
+  velocity->header.stamp = now;
+  velocity->vector.x = sample.velocity[0] / 1000.0;
+  velocity->vector.y = sample.velocity[1] / 1000.0;
+  velocity->vector.z = sample.velocity[2] / 1000.0;
+  velocity_publisher_.publish(velocity);
+
+  if (acceleration_publisher_)
+  {
+    geometry_msgs::Vector3StampedPtr acceleration = acceleration_pool_.acquire();
+    acceleration->header.stamp = now;
+    acceleration->vector.x = sample.acceleration[0] / 1000.0;
+    acceleration->vector.y = sample.acceleration[1] / 1000.0;
+    acceleration->vector.z = sample.acceleration[2] / 1000.0;
+    acceleration_publisher_.publish(acceleration);
+  }
+
+  // Angles as computed by the servo loop, without any model offsets
+  sensor_msgs::JointStatePtr joint_state = joint_state_pool_.acquire();
+  joint_state->header.stamp = now;
+  for (int i = 0; i < 6; i++)
+  {
+    joint_state->position[i] = sample.thetas[i + 1];
+    joint_state->velocity[i] = sample.theta_velocities[i + 1];
+  }
+  joint_state_publisher_.publish(joint_state);
+
+  if (link_publisher_)
+  {
+    tf2_msgs::TFMessagePtr links = link_pool_.acquire();
+    geometry_msgs::Transform transforms[6];
+    link_transforms(sample.thetas, link_lengths_, transforms);
+    for (int i = 0; i < 6; i++)
+    {
+      links->transforms[i].header.stamp = now;
+      links->transforms[i].transform = transforms[i];
+    }
+    link_publisher_.publish(links);
+  }
+}
+
+void PhantomROS::sample_pose(const PhantomSample& sample, geometry_msgs::Pose& pose) const
+{
+  const tf::Transform& sensable = sensable_transform_;
+  tf::Transform tf_cur_transform;
+
+  // Convert column-major matrix to row-major
+  tf_cur_transform.setFromOpenGLMatrix(sample.transform);
+  // Scale from mm to m
+  tf_cur_transform.setOrigin(tf_cur_transform.getOrigin() / 1000.0);
+  // Since hd_cur_transform is defined w.r.t. sensable_frame
+  tf_cur_transform = sensable * tf_cur_transform;
+  // Rotate end-effector back to base
+  tf_cur_transform.setRotation(tf_cur_transform.getRotation() * sensable.getRotation().inverse());
+
+  tf::poseTFToMsg(tf_cur_transform, pose);
+}
+
+void PhantomROS::publish_batches()
+{
+  if (!batch_)
+    return;
+
+  // Maps CLOCK_MONOTONIC sample stamps to ROS time
+  ros::Time now = ros::Time::now();
+  int64_t now_ns = monotonic_ns();
+
+  PhantomSample sample;
+  while (state_->batch_queue.pop(sample))
+  {
+    batch_->samples.push_back(ServoSample());
+    ServoSample& s = batch_->samples.back();
+    s.stamp = now - ros::Duration((now_ns - sample.stamp_ns) * 1e-9);
+    s.tick = sample.tick;
+    sample_pose(sample, s.pose);
+    s.velocity.x = sample.velocity[0] / 1000.0;
+    s.velocity.y = sample.velocity[1] / 1000.0;
+    s.velocity.z = sample.velocity[2] / 1000.0;
+    s.acceleration.x = sample.acceleration[0] / 1000.0;
+    s.acceleration.y = sample.acceleration[1] / 1000.0;
+    s.acceleration.z = sample.acceleration[2] / 1000.0;
+    for (int i = 0; i < 3; i++)
+    {
+      s.joints[i] = sample.joints[i];
+      s.gimbal[i] = sample.rot[i];
+    }
+    s.buttons = (sample.buttons[0] ? 1 : 0) | (sample.buttons[1] ? 2 : 0);
+
+    if ((int)batch_->samples.size() >= batch_size_)
+    {
+      batch_->header.stamp = batch_->samples.back().stamp;
+      batch_publisher_.publish(batch_);
+      batch_ = batch_pool_.acquire();
+      // Reused batches keep their capacity
+      batch_->samples.clear();
+      batch_->samples.reserve(batch_size_);
+    }
+  }
+
+  unsigned long dropped = state_->batch_dropped.load(std::memory_order_relaxed);
+  if (dropped != batch_dropped_)
+  {
+    ROS_WARN_THROTTLE(1.0, "Servo sample stream dropped %lu samples, publisher is too slow", dropped - batch_dropped_);
+    batch_dropped_ = dropped;
+  }
+}
+
+void PhantomROS::publish_buttons()
+{
+  // Stamped when the servo loop saw the edge, not when it is published
+  ros::Time now = ros::Time::now();
+  int64_t now_ns = monotonic_ns();
+  ButtonEvent event;
+  while (state_->button_queue.pop(event))
+  {
+    PhantomButtonEventPtr button_event = button_pool_.acquire();
+    button_event->grey_button = event.buttons[0];
+    button_event->white_button = event.buttons[1];
+    button_event->stamp = now - ros::Duration((now_ns - event.stamp_ns) * 1e-9);
+    button_event->sequence = event.sequence;
+    button_publisher_.publish(button_event);
+  }
+
+  unsigned long dropped = state_->button_dropped.load(std::memory_order_relaxed);
+  if (dropped != button_dropped_)
+  {
+    ROS_WARN_THROTTLE(1.0, "Dropped %lu button events, publisher is too slow", dropped - button_dropped_);
+    button_dropped_ = dropped;
+  }
+}
+
+void PhantomROS::publish_loop()
+{
+  if (event_driven_)
+  {
+    // Wake up on the servo signal and publish exactly the queued samples;
+    // the timeout only bounds how long stop() takes.
+    PhantomSample sample;
+    while (ros::ok() && running_)
+    {
+      if (!state_->publish_event.wait(100))
+        continue;
+      while (state_->publish_queue.pop(sample))
+        publish_sample(sample);
+      publish_buttons();
+      publish_batches();
+    }
+    return;
+  }
+
+  ros::Rate loop_rate(publish_rate_);
+
+  while (ros::ok() && running_)
+  {
+    publish_phantom_state();
+    publish_buttons();
+    publish_batches();
+    loop_rate.sleep();
+  }
+}
+
+void PhantomROS::stop()
+{
+  running_ = false;
+  diagnostics_timer_.stop();
+  wrench_sub_.shutdown();
+  scene_sub_.shutdown();
+  mesh_sub_.shutdown();
+  force_field_sub_.shutdown();
+  lock_gains_sub_.shutdown();
+  {
+    boost::mutex::scoped_lock lock(mesh_mutex_);
+    mesh_condition_.notify_all();
+  }
+  if (mesh_thread_.joinable())
+    mesh_thread_.join();
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ *
+ * Based on original code from Healthcare Robotics Lab at Georgia Tech
+ *
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sensable_phantom/phantom_kinematics.h"
+#include "sensable_phantom/phantom_state.h"
+
+namespace sensable_phantom
+{
+
+// Single writer counter, readers only need a recent value
+static inline void increment(std::atomic<unsigned long>& counter)
+{
+  counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+PhantomState::PhantomState() :
+    device(NULL), servo_rate(1000.0), measured_rate(false), kalman_enabled(false), gimbal_torque_enabled(false),
+    lock(false), tick(0), publish_decimation(0), publish_countdown(0), batch_enabled(false), batch_dropped(0),
+    button_sequence(0), button_dropped(0), log_queue(NULL), log_dropped(0), mesh(NULL), mesh_hazard(NULL),
+    force_fields(NULL), command_socket(NULL), command_timeout_ns(0), command_damping(0.0), command_max_force(0.0),
+    remote_received(0), remote_stale(0)
+{
+  memset(position, 0, sizeof(position));
+  memset(velocity, 0, sizeof(velocity));
+  memset(acceleration, 0, sizeof(acceleration));
+  memset(rot, 0, sizeof(rot));
+  memset(joints, 0, sizeof(joints));
+  memset(force, 0, sizeof(force));
+  memset(torque, 0, sizeof(torque));
+  memset(thetas, 0, sizeof(thetas));
+  memset(theta_velocities, 0, sizeof(theta_velocities));
+  memset(&remote_command, 0, sizeof(remote_command));
+  buttons[0] = 0;
+  buttons[1] = 0;
+  for (int i = 0; i < 16; i++)
+    hd_cur_transform[i] = (i % 5 == 0) ? 1.0 : 0.0;
+}
+
+// Hazard pointer: announce the model before using it and make sure it was
+// still current afterwards, so the ROS side cannot free it under our feet
+static inline const MeshModel *acquire_mesh(PhantomState *phantom_state)
+{
+  const MeshModel *mesh = phantom_state->mesh.load();
+  for (;;)
+  {
+    phantom_state->mesh_hazard.store(mesh);
+    const MeshModel *current = phantom_state->mesh.load();
+    if (current == mesh)
+      return mesh;
+    mesh = current;
+  }
+}
+
+bool phantom_state_callback(void *pUserData)
+{
+  PhantomState *phantom_state = static_cast<PhantomState *>(pUserData);
+  phantom_state->stats.tick_begin();
+  if (phantom_state->measured_rate)
+  {
+    double rate = phantom_state->stats.measured_rate();
+    phantom_state->velocity_filter.set_sample_rate(rate);
+    phantom_state->joint_filter.set_sample_rate(rate);
+    phantom_state->gimbal_filter.set_sample_rate(rate);
+  }
+
+  // Never blocks; forces are only updated when the ROS side sent new ones
+  PhantomCommand command;
+  if (phantom_state->command.read(command))
+  {
+    memcpy(phantom_state->force, command.force, sizeof(phantom_state->force));
+    memcpy(phantom_state->torque, command.torque, sizeof(phantom_state->torque));
+  }
+
+  DeviceInput in;
+  phantom_state->device->begin_frame();
+  int64_t stamp_ns = monotonic_ns();
+  //Get angles, position, transform and buttons
+  phantom_state->device->read(in);
+  memcpy(phantom_state->rot, in.gimbal, sizeof(phantom_state->rot));
+  memcpy(phantom_state->position, in.position, sizeof(phantom_state->position));
+  memcpy(phantom_state->joints, in.joints, sizeof(phantom_state->joints));
+  memcpy(phantom_state->hd_cur_transform, in.transform, sizeof(phantom_state->hd_cur_transform));
+  int buttons[2] = {(in.buttons & BUTTON_1) ? 1 : 0, (in.buttons & BUTTON_2) ? 1 : 0};
+  if (buttons[0] != phantom_state->buttons[0] || buttons[1] != phantom_state->buttons[1])
+  {
+    // Pressing both buttons toggles the lock
+    if (buttons[0] == 1 && buttons[1] == 1)
+      phantom_state->lock = !phantom_state->lock;
+
+    ButtonEvent event;
+    event.stamp_ns = stamp_ns;
+    event.sequence = phantom_state->button_sequence++;
+    event.buttons[0] = buttons[0];
+    event.buttons[1] = buttons[1];
+    if (!phantom_state->button_queue.push(event))
+      increment(phantom_state->button_dropped);
+  }
+  phantom_state->buttons[0] = buttons[0];
+  phantom_state->buttons[1] = buttons[1];
+
+  if (phantom_state->kalman_enabled)
+    phantom_state->kalman.step(phantom_state->position, phantom_state->velocity, phantom_state->acceleration); //mm/s, mm/s^2
+  else
+    phantom_state->velocity_filter.step(phantom_state->position, phantom_state->velocity); //mm/s
+
+  // Remote command straight from the socket, bypassing ROS
+  if (phantom_state->command_socket)
+  {
+    if (phantom_state->command_socket->receive(phantom_state->remote_command))
+      increment(phantom_state->remote_received);
+
+    int64_t age = realtime_ns() - phantom_state->remote_command.stamp_ns;
+    if (age < phantom_state->command_timeout_ns && age > -phantom_state->command_timeout_ns)
+    {
+      double force[3], norm = 0.0;
+      for (int i = 0; i < 3; i++)
+      {
+        force[i] = phantom_state->remote_command.force[i] - phantom_state->command_damping * phantom_state->velocity[i];
+        norm += force[i] * force[i];
+        phantom_state->torque[i] = phantom_state->remote_command.torque[i];
+      }
+      // Whatever the sender asks for, the hand holding the stylus gets at most this
+      norm = sqrt(norm);
+      double scale = norm > phantom_state->command_max_force ? phantom_state->command_max_force / norm : 1.0;
+      for (int i = 0; i < 3; i++)
+        phantom_state->force[i] = scale * force[i];
+    }
+    else
+    {
+      // Sender is gone or late; never keep pushing a stale force
+      memset(phantom_state->force, 0, sizeof(phantom_state->force));
+      memset(phantom_state->torque, 0, sizeof(phantom_state->torque));
+      increment(phantom_state->remote_stale);
+    }
+  }
+
+  //	printf("position x, y, z: %f %f %f \node_", phantom_state->position[0], phantom_state->position[1], phantom_state->position[2]);
+  //	printf("velocity x, y, z, time: %f %f %f \node_", phantom_state->velocity[0], phantom_state->velocity[1],phantom_state->velocity[2]);
+  // While locked, hold the stylus where it was when the lock engaged
+  phantom_state->lock_gains.update();
+  bool was_locked = phantom_state->lock_controller.engaged();
+  if (!phantom_state->lock_controller.update(phantom_state->lock, phantom_state->lock_gains.front(),
+                                             phantom_state->position, phantom_state->velocity,
+                                             1.0 / phantom_state->servo_rate, phantom_state->force) && was_locked)
+    memset(phantom_state->force, 0, sizeof(phantom_state->force));
+
+  // Set force and torque; local contacts add to the external force
+  DeviceOutput out;
+  memcpy(out.force, phantom_state->force, sizeof(out.force));
+  memcpy(out.torque, phantom_state->torque, sizeof(out.torque));
+  phantom_state->scene.update();
+  phantom_state->scene.front().render(phantom_state->position, phantom_state->velocity, out.force);
+  const MeshModel *previous = phantom_state->mesh_hazard.load(std::memory_order_relaxed);
+  const MeshModel *mesh = acquire_mesh(phantom_state);
+  if (mesh != previous)
+    phantom_state->mesh_proxy = MeshProxy();
+  if (mesh)
+    mesh->render(phantom_state->position, phantom_state->velocity, phantom_state->mesh_proxy, out.force);
+
+  if (phantom_state->force_fields)
+  {
+    ForceFieldInput field_in;
+    field_in.tick = phantom_state->tick;
+    field_in.dt = 1.0 / phantom_state->servo_rate;
+    memcpy(field_in.position, phantom_state->position, sizeof(field_in.position));
+    memcpy(field_in.velocity, phantom_state->velocity, sizeof(field_in.velocity));
+    memcpy(field_in.acceleration, phantom_state->acceleration, sizeof(field_in.acceleration));
+    memcpy(field_in.gimbal, phantom_state->rot, sizeof(field_in.gimbal));
+    memcpy(field_in.joints, phantom_state->joints, sizeof(field_in.joints));
+    field_in.buttons[0] = phantom_state->buttons[0];
+    field_in.buttons[1] = phantom_state->buttons[1];
+    phantom_state->force_fields->update(field_in, out.force, out.torque);
+  }
+
+  // 6-DoF devices take the torque about their gimbal axes
+  if (phantom_state->gimbal_torque_enabled)
+    gimbal_torques(phantom_state->joints, phantom_state->rot, out.torque, out.gimbal_torque);
+  else
+    memset(out.gimbal_torque, 0, sizeof(out.gimbal_torque));
+  phantom_state->device->write(out);
+
+  // A fatal error still hands this tick over, so the log shows what led to it
+  bool ok = phantom_state->device->end_frame();
+
+  double t[7] = {0., phantom_state->joints[0], phantom_state->joints[1], phantom_state->joints[2] - phantom_state->joints[1],
+                phantom_state->rot[0], phantom_state->rot[1], phantom_state->rot[2]};
+  for (int i = 0; i < 7; i++)
+    phantom_state->thetas[i] = (float)t[i];
+
+  double joint_velocity[3], gimbal_velocity[3];
+  phantom_state->joint_filter.step(phantom_state->joints, joint_velocity); //rad/s
+  phantom_state->gimbal_filter.step(phantom_state->rot, gimbal_velocity);
+  double w[7] = {0., joint_velocity[0], joint_velocity[1], joint_velocity[2] - joint_velocity[1], gimbal_velocity[0],
+                 gimbal_velocity[1], gimbal_velocity[2]};
+  for (int i = 0; i < 7; i++)
+    phantom_state->theta_velocities[i] = (float)w[i];
+
+  // Hand a consistent snapshot over to the ROS side
+  PhantomSample sample;
+  sample.tick = phantom_state->tick++;
+  sample.stamp_ns = stamp_ns;
+  memcpy(sample.position, phantom_state->position, sizeof(sample.position));
+  memcpy(sample.velocity, phantom_state->velocity, sizeof(sample.velocity));
+  memcpy(sample.acceleration, phantom_state->acceleration, sizeof(sample.acceleration));
+  memcpy(sample.rot, phantom_state->rot, sizeof(sample.rot));
+  memcpy(sample.joints, phantom_state->joints, sizeof(sample.joints));
+  memcpy(sample.transform, phantom_state->hd_cur_transform, sizeof(sample.transform));
+  for (int i = 0; i < 7; i++)
+  {
+    sample.thetas[i] = phantom_state->thetas[i];
+    sample.theta_velocities[i] = phantom_state->theta_velocities[i];
+  }
+  sample.buttons[0] = phantom_state->buttons[0];
+  sample.buttons[1] = phantom_state->buttons[1];
+  sample.error = phantom_state->device->last_error();
+  phantom_state->sample.store(sample);
+
+  // Flight log, with the force and torque the device actually got
+  if (phantom_state->log_queue)
+  {
+    FlightLogRecord record;
+    record.tick = sample.tick;
+    record.stamp_ns = stamp_ns;
+    memcpy(record.position, sample.position, sizeof(record.position));
+    memcpy(record.velocity, sample.velocity, sizeof(record.velocity));
+    memcpy(record.transform, sample.transform, sizeof(record.transform));
+    memcpy(record.joints, sample.joints, sizeof(record.joints));
+    memcpy(record.gimbal, sample.rot, sizeof(record.gimbal));
+    memcpy(record.force, out.force, sizeof(record.force));
+    memcpy(record.torque, out.torque, sizeof(record.torque));
+    record.buttons = in.buttons;
+    record.error = sample.error;
+    if (!phantom_state->log_queue->push(record))
+      increment(phantom_state->log_dropped);
+  }
+
+  // Lossless stream; the publisher drains it in batches
+  if (phantom_state->batch_enabled && !phantom_state->batch_queue.push(sample))
+    increment(phantom_state->batch_dropped);
+
+  // Deterministic decimation for the event driven publisher
+  if (phantom_state->publish_decimation && ++phantom_state->publish_countdown >= phantom_state->publish_decimation)
+  {
+    phantom_state->publish_countdown = 0;
+    if (phantom_state->publish_queue.push(sample))
+      phantom_state->publish_event.notify();
+  }
+
+  phantom_state->stats.tick_end();
+  return ok;
+}
+
+bool phantom_group_callback(void *pUserData)
+{
+  PhantomGroup *group = static_cast<PhantomGroup *>(pUserData);
+
+  // OpenHaptics does not expose its servo thread, so it sets itself up here
+  if (group->servo_setup.load(std::memory_order_relaxed) == 0)
+  {
+    int ret = 0;
+    if (group->realtime.enabled)
+    {
+      prefault_stack(group->realtime.stack_prefault);
+      ret = set_thread_realtime(pthread_self(), group->realtime.servo_priority, group->realtime.servo_cpu);
+    }
+    group->servo_setup.store(ret ? -ret : 1, std::memory_order_release);
+  }
+
+  bool any = false;
+  for (size_t i = 0; i < group->states.size(); i++)
+  {
+    if (!group->active[i])
+      continue;
+    // Each device makes itself current in begin_frame()
+    if (!phantom_state_callback(group->states[i]))
+      group->active[i] = 0;
+    else
+      any = true;
+  }
+  return any;
+}
+
+} // namespace sensable_phantom
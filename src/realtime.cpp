@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <alloca.h>
+#include <errno.h>
+#include <malloc.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <sstream>
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/realtime.h"
+
+namespace sensable_phantom
+{
+
+RealtimeConfig::RealtimeConfig() :
+    enabled(false), lock_memory(true), stack_prefault(64 * 1024), servo_priority(0), servo_cpu(-1),
+    publish_priority(0), publish_cpu(-1), callback_priority(0), callback_cpu(-1)
+{
+}
+
+int RealtimeConfig::load(const ros::NodeHandle& pnode)
+{
+  pnode.param(std::string("realtime"), enabled, false);
+  if (!enabled)
+    return 0;
+
+  int prefault;
+  pnode.param(std::string("realtime_lock_memory"), lock_memory, true);
+  pnode.param(std::string("realtime_stack_prefault"), prefault, 64 * 1024);
+  // The OpenHaptics servo thread already runs at a high priority; pinning it is usually enough
+  pnode.param(std::string("realtime_servo_priority"), servo_priority, 0);
+  pnode.param(std::string("realtime_servo_cpu"), servo_cpu, -1);
+  pnode.param(std::string("realtime_publish_priority"), publish_priority, 70);
+  pnode.param(std::string("realtime_publish_cpu"), publish_cpu, -1);
+  pnode.param(std::string("realtime_callback_priority"), callback_priority, 60);
+  pnode.param(std::string("realtime_callback_cpu"), callback_cpu, -1);
+  stack_prefault = prefault > 0 ? prefault : 0;
+
+  int min = sched_get_priority_min(SCHED_FIFO);
+  int max = sched_get_priority_max(SCHED_FIFO);
+  int priorities[3] = {servo_priority, publish_priority, callback_priority};
+  for (int i = 0; i < 3; i++)
+  {
+    if (priorities[i] != 0 && (priorities[i] < min || priorities[i] > max))
+    {
+      ROS_FATAL("SCHED_FIFO priorities must be in [%d, %d], or 0 to leave the policy alone", min, max);
+      return -1;
+    }
+  }
+
+  long cpus = sysconf(_SC_NPROCESSORS_CONF);
+  int affinities[3] = {servo_cpu, publish_cpu, callback_cpu};
+  for (int i = 0; i < 3; i++)
+  {
+    if (affinities[i] >= cpus)
+    {
+      ROS_FATAL("CPU %d does not exist, this machine has %ld", affinities[i], cpus);
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int lock_memory()
+{
+  // Freed memory is kept by malloc instead of being given back and faulted in again
+  mallopt(M_TRIM_THRESHOLD, -1);
+  mallopt(M_MMAP_MAX, 0);
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    return errno;
+  return 0;
+}
+
+void prefault_stack(size_t bytes)
+{
+  if (bytes == 0)
+    return;
+  volatile char *stack = (volatile char *)alloca(bytes);
+  long page = sysconf(_SC_PAGESIZE);
+  for (size_t i = 0; i < bytes; i += page)
+    stack[i] = 0;
+}
+
+int set_thread_realtime(pthread_t thread, int priority, int cpu)
+{
+  if (cpu >= 0)
+  {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (ret)
+      return ret;
+  }
+
+  if (priority > 0)
+  {
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = priority;
+    int ret = pthread_setschedparam(thread, SCHED_FIFO, &param);
+    if (ret)
+      return ret;
+  }
+  return 0;
+}
+
+std::string describe_realtime(int priority, int cpu)
+{
+  std::ostringstream stream;
+  if (priority > 0)
+    stream << "SCHED_FIFO " << priority;
+  else
+    stream << "default policy";
+  if (cpu >= 0)
+    stream << " on CPU " << cpu;
+  else
+    stream << " on any CPU";
+  return stream.str();
+}
+
+} // namespace sensable_phantom
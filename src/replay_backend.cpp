@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include "sensable_phantom/replay_backend.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <map>
+#include <sstream>
+
+#include <ros/ros.h>
+
+#include "sensable_phantom/phantom_kinematics.h"
+
+namespace sensable_phantom
+{
+
+static std::string trim(const std::string& s)
+{
+  size_t begin = 0, end = s.size();
+  while (begin < end && isspace(s[begin]))
+    begin++;
+  while (end > begin && isspace(s[end - 1]))
+    end--;
+  return s.substr(begin, end - begin);
+}
+
+static int load_csv(const std::string& path, ReplayTrajectory& trajectory)
+{
+  std::ifstream file(path.c_str());
+  if (!file)
+  {
+    ROS_ERROR("Cannot open trajectory %s", path.c_str());
+    return -1;
+  }
+
+  // Fields of a record, in the order of the columns they come from
+  static const char *const names[] = {"x", "y", "z", "joint0", "joint1", "joint2", "gimbal0", "gimbal1", "gimbal2",
+                                      "buttons", "fx", "fy", "fz", "tx", "ty", "tz"};
+  static const int FIELDS = sizeof(names) / sizeof(names[0]);
+
+  std::string line;
+  std::map<std::string, int> header;
+  if (std::getline(file, line))
+  {
+    std::istringstream stream(line);
+    std::string name;
+    for (int column = 0; std::getline(stream, name, ','); column++)
+      header[trim(name)] = column;
+  }
+
+  int columns[FIELDS];
+  for (int i = 0; i < FIELDS; i++)
+  {
+    std::map<std::string, int>::const_iterator it = header.find(names[i]);
+    columns[i] = it == header.end() ? -1 : it->second;
+    if (i < 3 && columns[i] < 0)
+    {
+      ROS_ERROR("Trajectory %s has no '%s' column", path.c_str(), names[i]);
+      return -1;
+    }
+  }
+
+  std::vector<double> values;
+  for (size_t row = 2; std::getline(file, line); row++)
+  {
+    if (trim(line).empty())
+      continue;
+
+    values.clear();
+    const char *p = line.c_str();
+    for (;;)
+    {
+      char *end;
+      values.push_back(strtod(p, &end));
+      if (end == p && *p != ',' && *p != '\0')
+      {
+        ROS_ERROR("Trajectory %s, line %zu: not a number", path.c_str(), row);
+        return -1;
+      }
+      p = strchr(end, ',');
+      if (!p)
+        break;
+      p++;
+    }
+
+    double field[FIELDS];
+    for (int i = 0; i < FIELDS; i++)
+      field[i] = (columns[i] >= 0 && columns[i] < (int)values.size()) ? values[columns[i]] : 0.0;
+
+    FlightLogRecord record;
+    memset(&record, 0, sizeof(record));
+    record.tick = trajectory.records.size();
+    record.stamp_ns = (int64_t)(record.tick * 1e9 / trajectory.rate);
+    for (int i = 0; i < 3; i++)
+    {
+      record.position[i] = field[i];
+      record.joints[i] = field[3 + i];
+      record.gimbal[i] = field[6 + i];
+      record.force[i] = field[10 + i];
+      record.torque[i] = field[13 + i];
+    }
+    record.buttons = (int32_t)field[9];
+    stylus_transform(record.joints, record.gimbal, record.position, record.transform);
+    trajectory.records.push_back(record);
+  }
+
+  trajectory.model = "PHANToM (replay)";
+  return 0;
+}
+
+int load_trajectory(const std::string& path, double csv_rate, ReplayTrajectory& trajectory)
+{
+  trajectory.path = path;
+  trajectory.records.clear();
+
+  size_t dot = path.rfind('.');
+  std::string ext = dot == std::string::npos ? "" : path.substr(dot + 1);
+  for (size_t i = 0; i < ext.size(); i++)
+    ext[i] = tolower(ext[i]);
+
+  if (ext == "csv")
+  {
+    trajectory.rate = csv_rate;
+    if (load_csv(path, trajectory))
+      return -1;
+  }
+  else
+  {
+    FlightLogHeader header;
+    if (read_flight_log(path, header, trajectory.records))
+      return -1;
+    trajectory.rate = header.servo_rate;
+    trajectory.model = std::string(header.model, strnlen(header.model, sizeof(header.model))) + " (replay)";
+  }
+
+  if (trajectory.records.empty())
+  {
+    ROS_ERROR("Trajectory %s is empty", path.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+ReplayConfig::ReplayConfig() : csv_rate(1000.0), realtime(true), loop(false), shutdown(true)
+{
+}
+
+ReplayDevice::ReplayDevice(ReplayTrajectory& trajectory, ReplayBackend& backend, bool loop) :
+    captured_(0), tick_(0), first_pass_(true), backend_(backend), loop_(loop)
+{
+  trajectory_.path = trajectory.path;
+  trajectory_.model = trajectory.model;
+  trajectory_.rate = trajectory.rate;
+  trajectory_.records.swap(trajectory.records);
+  DeviceOutput zero;
+  memset(&zero, 0, sizeof(zero));
+  output_.resize(trajectory_.records.size(), zero);
+}
+
+void ReplayDevice::read(DeviceInput& in)
+{
+  const FlightLogRecord& record = trajectory_.records[tick_];
+  memcpy(in.position, record.position, sizeof(in.position));
+  memcpy(in.transform, record.transform, sizeof(in.transform));
+  memcpy(in.joints, record.joints, sizeof(in.joints));
+  memcpy(in.gimbal, record.gimbal, sizeof(in.gimbal));
+  in.buttons = record.buttons;
+}
+
+void ReplayDevice::write(const DeviceOutput& out)
+{
+  if (!first_pass_)
+    return;
+  output_[tick_] = out;
+  captured_.store(tick_ + 1, std::memory_order_release);
+}
+
+bool ReplayDevice::end_frame()
+{
+  if (++tick_ < trajectory_.records.size())
+    return true;
+
+  if (first_pass_)
+  {
+    first_pass_ = false;
+    backend_.finished();
+  }
+  if (!loop_)
+    return false;
+  tick_ = 0;
+  return true;
+}
+
+ReplayBackend::ReplayBackend(const ReplayConfig& config) :
+    config_(config), rate_(0.0), finished_(0), started_(false)
+{
+}
+
+ReplayBackend::~ReplayBackend()
+{
+  stop();
+  for (size_t i = 0; i < devices_.size(); i++)
+    delete devices_[i];
+}
+
+PhantomDevice* ReplayBackend::open(const std::string& name)
+{
+  if (devices_.size() >= config_.files.size())
+  {
+    ROS_ERROR("No replay file for device %zu '%s', %zu given", devices_.size(), name.c_str(), config_.files.size());
+    return NULL;
+  }
+
+  ReplayTrajectory trajectory;
+  const std::string& path = config_.files[devices_.size()];
+  if (load_trajectory(path, config_.csv_rate, trajectory))
+    return NULL;
+
+  // A single scheduler drives every device
+  if (!devices_.empty() && trajectory.rate != rate_)
+  {
+    ROS_ERROR("Trajectory %s was recorded at %g Hz, the others at %g Hz", path.c_str(), trajectory.rate, rate_);
+    return NULL;
+  }
+  rate_ = trajectory.rate;
+
+  ROS_INFO("Replaying %s: %zu samples, %.1f s at %g Hz%s", path.c_str(), trajectory.records.size(),
+           trajectory.records.size() / rate_, rate_, config_.realtime ? "" : ", as fast as possible");
+  ReplayDevice *device = new ReplayDevice(trajectory, *this, config_.loop);
+  devices_.push_back(device);
+  return device;
+}
+
+bool ReplayBackend::start()
+{
+  if (!scheduler_.start(config_.realtime ? rate_ : 0.0))
+    return false;
+  started_ = true;
+  return true;
+}
+
+void ReplayBackend::stop()
+{
+  scheduler_.stop();
+  if (!started_)
+    return;
+  started_ = false;
+  if (!config_.output_file.empty())
+    save_output();
+}
+
+void ReplayBackend::schedule(ServoCallback callback, void *user_data)
+{
+  scheduler_.schedule(callback, user_data);
+}
+
+void ReplayBackend::finished()
+{
+  // requestShutdown() only raises a flag, it is fine on the servo thread
+  if (finished_.fetch_add(1) + 1 == (int)devices_.size() && config_.shutdown)
+    ros::requestShutdown();
+}
+
+int ReplayBackend::save_output() const
+{
+  FILE *file = fopen(config_.output_file.c_str(), "w");
+  if (!file)
+  {
+    ROS_ERROR("Cannot write replay output %s: %s", config_.output_file.c_str(), strerror(errno));
+    return -1;
+  }
+
+  fprintf(file, "device,tick,fx,fy,fz,tx,ty,tz,recorded_fx,recorded_fy,recorded_fz,"
+          "recorded_tx,recorded_ty,recorded_tz\n");
+  for (size_t d = 0; d < devices_.size(); d++)
+  {
+    const ReplayDevice *device = devices_[d];
+    size_t n = device->captured();
+    for (size_t k = 0; k < n; k++)
+    {
+      const DeviceOutput& out = device->output()[k];
+      const FlightLogRecord& record = device->trajectory().records[k];
+      fprintf(file, "%zu,%zu", d, k);
+      for (int i = 0; i < 3; i++)
+        fprintf(file, ",%.9g", out.force[i]);
+      for (int i = 0; i < 3; i++)
+        fprintf(file, ",%.9g", out.torque[i]);
+      for (int i = 0; i < 3; i++)
+        fprintf(file, ",%.9g", record.force[i]);
+      for (int i = 0; i < 3; i++)
+        fprintf(file, ",%.9g", record.torque[i]);
+      fprintf(file, "\n");
+    }
+    ROS_INFO("Replay output of %s: %zu of %zu ticks", device->trajectory().path.c_str(), n,
+             device->trajectory().records.size());
+  }
+
+  if (fclose(file))
+  {
+    ROS_ERROR("Cannot write replay output %s: %s", config_.output_file.c_str(), strerror(errno));
+    return -1;
+  }
+  return 0;
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include "sensable_phantom/servo_scheduler.h"
+
+#include <errno.h>
+#include <time.h>
+
+namespace sensable_phantom
+{
+
+ServoScheduler::ServoScheduler() : rate_(0.0), started_(false), running_(false), count_(0)
+{
+}
+
+ServoScheduler::~ServoScheduler()
+{
+  stop();
+}
+
+bool ServoScheduler::start(double rate)
+{
+  if (started_)
+    return false;
+
+  rate_ = rate;
+  running_.store(true, std::memory_order_release);
+  if (pthread_create(&thread_, NULL, &ServoScheduler::run, this) != 0)
+  {
+    running_.store(false, std::memory_order_release);
+    return false;
+  }
+  started_ = true;
+  return true;
+}
+
+void ServoScheduler::stop()
+{
+  if (!started_)
+    return;
+
+  running_.store(false, std::memory_order_release);
+  pthread_join(thread_, NULL);
+  started_ = false;
+}
+
+bool ServoScheduler::schedule(ServoCallback callback, void *user_data)
+{
+  int n = count_.load(std::memory_order_relaxed);
+  if (n >= MAX_CALLBACKS)
+    return false;
+
+  entries_[n].callback = callback;
+  entries_[n].user_data = user_data;
+  entries_[n].active = true;
+  // Publishes the entry to the servo thread
+  count_.store(n + 1, std::memory_order_release);
+  return true;
+}
+
+void *ServoScheduler::run(void *ptr)
+{
+  static_cast<ServoScheduler *>(ptr)->loop();
+  return NULL;
+}
+
+void ServoScheduler::loop()
+{
+  const long period_ns = rate_ > 0 ? (long)(1e9 / rate_) : 0;
+
+  struct timespec next;
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (running_.load(std::memory_order_acquire))
+  {
+    int n = count_.load(std::memory_order_acquire);
+    for (int i = 0; i < n; i++)
+    {
+      Entry& e = entries_[i];
+      if (e.active && !e.callback(e.user_data))
+        e.active = false;
+    }
+
+    if (period_ns == 0)
+      continue;
+
+    next.tv_nsec += period_ns;
+    while (next.tv_nsec >= 1000000000L)
+    {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL) == EINTR)
+      ;
+  }
+}
+
+} // namespace sensable_phantom
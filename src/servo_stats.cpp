@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include "sensable_phantom/servo_stats.h"
+
+namespace sensable_phantom
+{
+
+int HistogramSnapshot::index(uint64_t value)
+{
+  if (value < (uint64_t)(2 * SUB_BUCKETS))
+    return (int)value;
+
+  int msb = 63 - __builtin_clzll(value);
+  int exponent = msb - SUB_BUCKET_BITS;
+  if (exponent > MAX_EXPONENT)
+    return BUCKETS - 1;
+  return 2 * SUB_BUCKETS + (exponent - 1) * SUB_BUCKETS + (int)(value >> exponent) - SUB_BUCKETS;
+}
+
+uint64_t HistogramSnapshot::highest_equivalent(int i)
+{
+  if (i < 2 * SUB_BUCKETS)
+    return i;
+
+  int exponent = (i - 2 * SUB_BUCKETS) / SUB_BUCKETS + 1;
+  uint64_t mantissa = (i - 2 * SUB_BUCKETS) % SUB_BUCKETS + SUB_BUCKETS;
+  return ((mantissa + 1) << exponent) - 1;
+}
+
+uint64_t HistogramSnapshot::total() const
+{
+  uint64_t n = 0;
+  for (int i = 0; i < BUCKETS; i++)
+    n += counts[i];
+  return n;
+}
+
+uint64_t HistogramSnapshot::percentile(double q) const
+{
+  uint64_t n = total();
+  if (n == 0)
+    return 0;
+
+  uint64_t rank = (uint64_t)(q * n + 0.5);
+  if (rank < 1)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    seen += counts[i];
+    if (seen >= rank)
+      return highest_equivalent(i);
+  }
+  return highest_equivalent(BUCKETS - 1);
+}
+
+uint64_t HistogramSnapshot::max() const
+{
+  for (int i = BUCKETS - 1; i >= 0; i--)
+  {
+    if (counts[i])
+      return highest_equivalent(i);
+  }
+  return 0;
+}
+
+double HistogramSnapshot::mean() const
+{
+  double sum = 0.0;
+  uint64_t n = 0;
+  for (int i = 0; i < BUCKETS; i++)
+  {
+    if (!counts[i])
+      continue;
+    // Middle of the bucket
+    uint64_t lo = i > 0 ? highest_equivalent(i - 1) + 1 : 0;
+    sum += counts[i] * 0.5 * (lo + highest_equivalent(i));
+    n += counts[i];
+  }
+  return n ? sum / n : 0.0;
+}
+
+void HistogramSnapshot::subtract(const HistogramSnapshot& older)
+{
+  for (int i = 0; i < BUCKETS; i++)
+    counts[i] -= older.counts[i];
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+  for (int i = 0; i < HistogramSnapshot::BUCKETS; i++)
+    counts_[i].store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::snapshot(HistogramSnapshot& s) const
+{
+  for (int i = 0; i < HistogramSnapshot::BUCKETS; i++)
+    s.counts[i] = counts_[i].load(std::memory_order_relaxed);
+}
+
+ServoStats::ServoStats() :
+    period_ns_(1000000), overrun_ns_(1100000), last_begin_ns_(0), mean_period_ns_(1e6), smoothing_(0.001)
+{
+}
+
+void ServoStats::configure(double rate, double tolerance)
+{
+  period_ns_ = (int64_t)(1e9 / rate);
+  overrun_ns_ = (int64_t)(period_ns_ * (1.0 + tolerance));
+  mean_period_ns_ = period_ns_;
+  // About a second worth of ticks
+  smoothing_ = rate > 1.0 ? 1.0 / rate : 1.0;
+}
+
+} // namespace sensable_phantom
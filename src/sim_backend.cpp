@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include "sensable_phantom/sim_backend.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "sensable_phantom/phantom_kinematics.h"
+
+namespace sensable_phantom
+{
+
+SimConfig::SimConfig() :
+    model("PHANToM Omni (simulated)"), rate(1000.0), frequency(0.2), gimbal_amplitude(0.5), mass(0.05),
+    stiffness(0.2), damping(0.002), max_force(3.3), button_period(4.0)
+{
+  amplitude[0] = 60.0;
+  amplitude[1] = 40.0;
+  amplitude[2] = 30.0;
+}
+
+SimDevice::SimDevice(const SimConfig& config, int index) :
+    config_(config), dt_(1.0 / config.rate), phase_(index * M_PI / 3), tick_(0)
+{
+  memset(offset_, 0, sizeof(offset_));
+  memset(offset_vel_, 0, sizeof(offset_vel_));
+  memset(&output_, 0, sizeof(output_));
+}
+
+void SimDevice::begin_frame()
+{
+  // Semi-implicit Euler step of the stylus held by a compliant hand
+  for (int i = 0; i < 3; i++)
+  {
+    double f = output_.force[i];
+    if (f > config_.max_force)
+      f = config_.max_force;
+    else if (f < -config_.max_force)
+      f = -config_.max_force;
+
+    double acc = (f - config_.stiffness * offset_[i] - config_.damping * offset_vel_[i]) / config_.mass
+        * 1000.0; // mm/s^2
+    offset_vel_[i] += acc * dt_;
+    offset_[i] += offset_vel_[i] * dt_;
+  }
+}
+
+void SimDevice::read(DeviceInput& in)
+{
+  const double t = tick_ * dt_;
+  const double w = 2 * M_PI * config_.frequency;
+
+  in.position[0] = config_.amplitude[0] * sin(w * t + phase_) + offset_[0];
+  in.position[1] = config_.amplitude[1] * sin(2 * w * t + phase_) + offset_[1];
+  in.position[2] = config_.amplitude[2] * sin(3 * w * t + phase_ + M_PI / 4) + offset_[2];
+
+  for (int i = 0; i < 3; i++)
+  {
+    in.gimbal[i] = config_.gimbal_amplitude * sin((i + 1) * 0.7 * w * t + phase_);
+    in.joints[i] = 0.5 * sin((i + 1) * 0.5 * w * t + phase_ + i);
+  }
+
+  stylus_transform(in.joints, in.gimbal, in.position, in.transform);
+
+  in.buttons = 0;
+  if (config_.button_period > 0)
+  {
+    double p = fmod(t, config_.button_period) / config_.button_period;
+    if (p >= 0.25 && p < 0.30)
+      in.buttons |= BUTTON_1;
+    if (p >= 0.75 && p < 0.80)
+      in.buttons |= BUTTON_2;
+  }
+}
+
+void SimDevice::write(const DeviceOutput& out)
+{
+  output_ = out;
+}
+
+SimBackend::SimBackend(const SimConfig& config) : config_(config)
+{
+}
+
+SimBackend::~SimBackend()
+{
+  stop();
+  for (size_t i = 0; i < devices_.size(); i++)
+    delete devices_[i];
+}
+
+PhantomDevice* SimBackend::open(const std::string& name)
+{
+  SimConfig config = config_;
+  if (!name.empty())
+    config.model += " " + name;
+
+  SimDevice *device = new SimDevice(config, devices_.size());
+  devices_.push_back(device);
+  return device;
+}
+
+bool SimBackend::start()
+{
+  return scheduler_.start(config_.rate);
+}
+
+void SimBackend::stop()
+{
+  scheduler_.stop();
+}
+
+void SimBackend::schedule(ServoCallback callback, void *user_data)
+{
+  scheduler_.schedule(callback, user_data);
+}
+
+} // namespace sensable_phantom
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "sensable_phantom/velocity_filter.h"
+
+namespace sensable_phantom
+{
+
+VelocityFilter::VelocityFilter() : order_(0), cutoff_(0.0), rate_(0.0), n_sections_(0), primed_(false)
+{
+  configure(3, 20.0, 1000.0);
+}
+
+int VelocityFilter::configure(int order, double cutoff, double rate)
+{
+  if (order < 1 || order > MAX_ORDER || rate <= 0.0 || cutoff <= 0.0 || cutoff >= rate / 2.0)
+    return -1;
+
+  order_ = order;
+  cutoff_ = cutoff;
+  rate_ = rate;
+  n_sections_ = 0;
+
+  double w0 = 2.0 * M_PI * cutoff / rate;
+  double cos_w0 = cos(w0);
+  double sin_w0 = sin(w0);
+
+  // Conjugate pole pairs at angle psi from the negative real axis, Q = 1 / (2 cos(psi)).
+  // Odd orders have a real pole at psi = 0, which shifts the pairs by half a step.
+  for (int k = 0; k < order / 2; k++)
+  {
+    double psi = M_PI * (2 * k + 1 + order % 2) / (2.0 * order);
+    double q = 1.0 / (2.0 * cos(psi));
+    double alpha = sin_w0 / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    Section& s = sections_[n_sections_++];
+    s.b0 = (1.0 - cos_w0) / 2.0 / a0;
+    s.b1 = (1.0 - cos_w0) / a0;
+    s.b2 = s.b0;
+    s.a1 = -2.0 * cos_w0 / a0;
+    s.a2 = (1.0 - alpha) / a0;
+  }
+
+  // Real pole of odd orders
+  if (order % 2)
+  {
+    double k = tan(w0 / 2.0);
+    Section& s = sections_[n_sections_++];
+    s.b0 = k / (1.0 + k);
+    s.b1 = s.b0;
+    s.b2 = 0.0;
+    s.a1 = (k - 1.0) / (k + 1.0);
+    s.a2 = 0.0;
+  }
+
+  reset();
+  return 0;
+}
+
+void VelocityFilter::reset()
+{
+  primed_ = false;
+  memset(pos_hist1_, 0, sizeof(pos_hist1_));
+  memset(pos_hist2_, 0, sizeof(pos_hist2_));
+  memset(z_, 0, sizeof(z_));
+}
+
+void VelocityFilter::step(const double position[3], double velocity[3])
+{
+  // Start from rest instead of from a jump away from the origin
+  if (!primed_)
+  {
+    memcpy(pos_hist1_, position, sizeof(pos_hist1_));
+    memcpy(pos_hist2_, position, sizeof(pos_hist2_));
+    primed_ = true;
+  }
+
+  for (int i = 0; i < 3; i++)
+  {
+    double x = (3.0 * position[i] - 4.0 * pos_hist1_[i] + pos_hist2_[i]) * rate_ / 2.0; //2nd order backward dif
+    pos_hist2_[i] = pos_hist1_[i];
+    pos_hist1_[i] = position[i];
+
+    for (int j = 0; j < n_sections_; j++)
+    {
+      const Section& s = sections_[j];
+      double *z = z_[j][i];
+      double y = s.b0 * x + z[0];
+      z[0] = s.b1 * x - s.a1 * y + z[1];
+      z[1] = s.b2 * x - s.a2 * y;
+      x = y;
+    }
+    velocity[i] = x;
+  }
+}
+
+} // namespace sensable_phantom
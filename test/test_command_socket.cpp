@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <limits>
+
+#include "sensable_phantom/command_socket.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+CommandPacket make_packet(int64_t stamp_ns, double fx)
+{
+  CommandPacket packet;
+  memset(&packet, 0, sizeof(packet));
+  packet.magic = CommandPacket::MAGIC;
+  packet.stamp_ns = stamp_ns;
+  packet.force[0] = fx;
+  return packet;
+}
+
+// Sends datagrams to a CommandSocket bound to the loopback interface
+class CommandSocketTest : public ::testing::Test
+{
+protected:
+  static const int64_t TOLERANCE_NS = 5000000;
+
+  void SetUp()
+  {
+    // Pick a free port, then hand it to the socket under test
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    memset(&addr_, 0, sizeof(addr_));
+    addr_.sin_family = AF_INET;
+    addr_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(probe, (struct sockaddr *)&addr_, sizeof(addr_));
+    socklen_t len = sizeof(addr_);
+    getsockname(probe, (struct sockaddr *)&addr_, &len);
+    ::close(probe);
+
+    ASSERT_EQ(0, socket_.open("127.0.0.1", ntohs(addr_.sin_port), TOLERANCE_NS));
+    sender_ = ::socket(AF_INET, SOCK_DGRAM, 0);
+  }
+
+  void TearDown()
+  {
+    ::close(sender_);
+  }
+
+  void send(const void *data, size_t size)
+  {
+    ASSERT_EQ((ssize_t)size, sendto(sender_, data, size, 0, (struct sockaddr *)&addr_, sizeof(addr_)));
+  }
+
+  void send(const CommandPacket& packet)
+  {
+    send(&packet, sizeof(packet));
+  }
+
+  CommandSocket socket_;
+  int sender_;
+  struct sockaddr_in addr_;
+};
+
+} // namespace
+
+TEST(CommandPacket, ParsesValidPacket)
+{
+  CommandPacket in = make_packet(123, 1.5), out;
+  in.torque[2] = -0.25;
+  ASSERT_TRUE(parse_command_packet(&in, sizeof(in), out));
+  EXPECT_EQ(123, out.stamp_ns);
+  EXPECT_EQ(1.5, out.force[0]);
+  EXPECT_EQ(-0.25, out.torque[2]);
+}
+
+TEST(CommandPacket, RejectsBadSizeAndMagic)
+{
+  CommandPacket in = make_packet(1, 1.0), out = make_packet(7, 7.0);
+  EXPECT_FALSE(parse_command_packet(&in, sizeof(in) - 1, out));
+  char big[sizeof(in) + 1];
+  memcpy(big, &in, sizeof(in));
+  EXPECT_FALSE(parse_command_packet(big, sizeof(big), out));
+  in.magic = 0;
+  EXPECT_FALSE(parse_command_packet(&in, sizeof(in), out));
+  // Rejected packets leave the output alone
+  EXPECT_EQ(7, out.stamp_ns);
+}
+
+TEST(CommandPacket, RejectsNonFiniteValues)
+{
+  CommandPacket out;
+  for (int i = 0; i < 6; i++)
+  {
+    CommandPacket nan = make_packet(1, 0.0), inf = make_packet(1, 0.0);
+    double *nan_values = i < 3 ? nan.force : nan.torque;
+    double *inf_values = i < 3 ? inf.force : inf.torque;
+    nan_values[i % 3] = std::numeric_limits<double>::quiet_NaN();
+    inf_values[i % 3] = -std::numeric_limits<double>::infinity();
+    EXPECT_FALSE(parse_command_packet(&nan, sizeof(nan), out));
+    EXPECT_FALSE(parse_command_packet(&inf, sizeof(inf), out));
+  }
+}
+
+TEST_F(CommandSocketTest, KeepsNewestAndDropsReordered)
+{
+  int64_t now = realtime_ns();
+  send(make_packet(now - 2000, 1.0));
+  send(make_packet(now - 1000, 2.0));
+  send(make_packet(now - 3000, 3.0));
+
+  CommandPacket packet;
+  ASSERT_TRUE(socket_.receive(packet));
+  EXPECT_EQ(2.0, packet.force[0]);
+  EXPECT_EQ(1u, socket_.rejected());
+  EXPECT_FALSE(socket_.receive(packet));
+}
+
+TEST_F(CommandSocketTest, FutureStampDoesNotBlockLaterPackets)
+{
+  int64_t now = realtime_ns();
+  send(make_packet(now + 3600LL * 1000000000LL, 9.0));
+  CommandPacket packet = make_packet(0, 0.0);
+  EXPECT_FALSE(socket_.receive(packet));
+  EXPECT_EQ(1u, socket_.rejected());
+
+  send(make_packet(realtime_ns(), 1.0));
+  ASSERT_TRUE(socket_.receive(packet));
+  EXPECT_EQ(1.0, packet.force[0]);
+}
+
+TEST_F(CommandSocketTest, ReadsBoundedNumberPerCall)
+{
+  // More than one call reads, as far as the small receive buffer takes them
+  for (int i = 0; i < 2 * CommandSocket::MAX_PACKETS_PER_RECEIVE; i++)
+  {
+    CommandPacket bad = make_packet(0, 0.0);
+    bad.magic = 0;
+    send(bad);
+  }
+  CommandPacket packet;
+  EXPECT_FALSE(socket_.receive(packet));
+  unsigned long first = socket_.rejected();
+  EXPECT_GT(first, 0u);
+  EXPECT_LE(first, (unsigned long)CommandSocket::MAX_PACKETS_PER_RECEIVE);
+  // The rest is left for the next tick
+  EXPECT_FALSE(socket_.receive(packet));
+  EXPECT_LE(socket_.rejected() - first, (unsigned long)CommandSocket::MAX_PACKETS_PER_RECEIVE);
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "sensable_phantom/flight_log.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+const uint64_t RECORDS = 100;
+
+// A log of RECORDS ticks written by FlightLogger, removed on destruction
+class FlightLogTest : public ::testing::Test
+{
+protected:
+  void SetUp()
+  {
+    char name[] = "/tmp/test_flight_logXXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    path_ = name;
+
+    FlightLogger logger;
+    ASSERT_EQ(0, logger.open(path_, 1.0, 1000.0, "/phantom", "sim"));
+    for (uint64_t k = 0; k < RECORDS; k++)
+    {
+      FlightLogRecord record;
+      memset(&record, 0, sizeof(record));
+      record.tick = k;
+      ASSERT_TRUE(logger.queue().push(record));
+    }
+    logger.stop();
+  }
+
+  void TearDown()
+  {
+    unlink(path_.c_str());
+  }
+
+  void set_count(uint64_t count)
+  {
+    std::fstream file(path_.c_str(), std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(offsetof(FlightLogHeader, count));
+    file.write((const char *)&count, sizeof(count));
+  }
+
+  std::string path_;
+};
+
+} // namespace
+
+TEST_F(FlightLogTest, ReadsWhatWasWritten)
+{
+  FlightLogHeader header;
+  std::vector<FlightLogRecord> records;
+  ASSERT_EQ(0, read_flight_log(path_, header, records));
+  EXPECT_EQ(RECORDS, header.count);
+  ASSERT_EQ(RECORDS, records.size());
+  for (uint64_t k = 0; k < RECORDS; k++)
+    EXPECT_EQ(k, records[k].tick);
+}
+
+// A corrupt count must not size the allocation
+TEST_F(FlightLogTest, CountIsBoundedByTheFileSize)
+{
+  set_count(1ULL << 60);
+  FlightLogHeader header;
+  std::vector<FlightLogRecord> records;
+  ASSERT_EQ(0, read_flight_log(path_, header, records));
+  EXPECT_EQ(RECORDS, records.size());
+  EXPECT_EQ(RECORDS - 1, records.back().tick);
+}
+
+TEST_F(FlightLogTest, TruncatedLogKeepsTheCompleteRecords)
+{
+  ASSERT_EQ(0, truncate(path_.c_str(), sizeof(FlightLogHeader) + 10 * sizeof(FlightLogRecord) + 7));
+  FlightLogHeader header;
+  std::vector<FlightLogRecord> records;
+  ASSERT_EQ(0, read_flight_log(path_, header, records));
+  EXPECT_EQ(RECORDS, header.count);
+  EXPECT_EQ(10u, records.size());
+}
+
+TEST_F(FlightLogTest, RejectsOtherFiles)
+{
+  FlightLogHeader header;
+  std::vector<FlightLogRecord> records;
+  ASSERT_EQ(0, truncate(path_.c_str(), sizeof(FlightLogHeader) / 2));
+  EXPECT_EQ(-1, read_flight_log(path_, header, records));
+  EXPECT_EQ(-1, read_flight_log("/nonexistent/log.phlog", header, records));
+}
@@ -0,0 +1,165 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+#include <string.h>
+
+#include "sensable_phantom/phantom_kinematics.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+const double POSES[][6] = {
+    {0.0, 0.0, 0.0, 0.0, 0.0, 0.0},
+    {0.3, -0.2, 0.5, 0.4, -0.7, 1.1},
+    {-0.8, 0.6, -0.4, -1.5, 0.9, -2.5},
+    {0.1, 0.2, 0.3, 2.8, 1.4, 0.2},
+};
+const int POSE_COUNT = sizeof(POSES) / sizeof(POSES[0]);
+
+// Rotation part of a column-major transform, R[row][column]
+void rotation(const double transform[16], double R[3][3])
+{
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      R[r][c] = transform[4 * c + r];
+}
+
+// R = q as a matrix
+void rotation(const geometry_msgs::Quaternion& q, double R[3][3])
+{
+  double x = q.x, y = q.y, z = q.z, w = q.w;
+  R[0][0] = 1 - 2 * (y * y + z * z);
+  R[0][1] = 2 * (x * y - z * w);
+  R[0][2] = 2 * (x * z + y * w);
+  R[1][0] = 2 * (x * y + z * w);
+  R[1][1] = 1 - 2 * (x * x + z * z);
+  R[1][2] = 2 * (y * z - x * w);
+  R[2][0] = 2 * (x * z - y * w);
+  R[2][1] = 2 * (y * z + x * w);
+  R[2][2] = 1 - 2 * (x * x + y * y);
+}
+
+void multiply(const double A[3][3], const double B[3][3], double C[3][3])
+{
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      C[r][c] = A[r][0] * B[0][c] + A[r][1] * B[1][c] + A[r][2] * B[2][c];
+}
+
+} // namespace
+
+// link_0 axes in sensable_origin, as published by the driver
+const double LINK_0[3][3] = {{0.0, -1.0, 0.0}, {0.0, 0.0, 1.0}, {-1.0, 0.0, 0.0}};
+
+TEST(Kinematics, StylusTransformIsLink0AtZero)
+{
+  const double zero[3] = {0.0, 0.0, 0.0};
+  const double position[3] = {1.0, 2.0, 3.0};
+  double transform[16];
+  stylus_transform(zero, zero, position, transform);
+  for (int r = 0; r < 3; r++)
+    for (int c = 0; c < 3; c++)
+      EXPECT_NEAR(LINK_0[r][c], transform[4 * c + r], 1e-12);
+  for (int c = 0; c < 3; c++)
+    EXPECT_EQ(0.0, transform[4 * c + 3]);
+  EXPECT_EQ(1.0, transform[12]);
+  EXPECT_EQ(2.0, transform[13]);
+  EXPECT_EQ(3.0, transform[14]);
+  EXPECT_EQ(1.0, transform[15]);
+}
+
+// The link chain published on /tf and the stylus transform are one rotation
+TEST(Kinematics, StylusTransformFollowsLinkChain)
+{
+  const double lengths[2] = {0.131, 0.137};
+  const double position[3] = {0.0, 0.0, 0.0};
+
+  for (int p = 0; p < POSE_COUNT; p++)
+  {
+    const double *joints = POSES[p], *rot = POSES[p] + 3;
+
+    // As the servo loop computes them
+    float thetas[7] = {0.0f, (float)joints[0], (float)joints[1], (float)(joints[2] - joints[1]),
+                       (float)rot[0], (float)rot[1], (float)rot[2]};
+    geometry_msgs::Transform links[6];
+    link_transforms(thetas, lengths, links);
+    double chain[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+    for (int i = 0; i < 6; i++)
+    {
+      double L[3][3], product[3][3];
+      rotation(links[i].rotation, L);
+      multiply(chain, L, product);
+      memcpy(chain, product, sizeof(chain));
+    }
+    double expected[3][3];
+    multiply(LINK_0, chain, expected);
+
+    double transform[16], R[3][3];
+    stylus_transform(joints, rot, position, transform);
+    rotation(transform, R);
+    for (int r = 0; r < 3; r++)
+      for (int c = 0; c < 3; c++)
+        EXPECT_NEAR(expected[r][c], R[r][c], 1e-6) << "pose " << p << " R(" << r << ", " << c << ")";
+  }
+}
+
+// Virtual work: a small turn of gimbal axis j by d rotates the stylus by
+// d * w_j, and the torque about that axis is t . w_j
+TEST(Kinematics, GimbalTorquesMatchFiniteDifferences)
+{
+  const double torque[3] = {0.3, -0.5, 0.8}; // Nm, sensable_origin
+  const double position[3] = {0.0, 0.0, 0.0};
+  const double h = 1e-6;
+
+  for (int p = 0; p < POSE_COUNT; p++)
+  {
+    const double *joints = POSES[p];
+    double rot[3] = {POSES[p][3], POSES[p][4], POSES[p][5]};
+
+    double gimbal_torque[3];
+    gimbal_torques(joints, rot, torque, gimbal_torque);
+
+    double transform[16], R[3][3];
+    stylus_transform(joints, rot, position, transform);
+    rotation(transform, R);
+    for (int j = 0; j < 3; j++)
+    {
+      double turned[3] = {rot[0], rot[1], rot[2]};
+      turned[j] += h;
+      double transform_h[16], Rh[3][3];
+      stylus_transform(joints, turned, position, transform_h);
+      rotation(transform_h, Rh);
+
+      // dR R^T = [w]x d
+      double W[3][3];
+      for (int r = 0; r < 3; r++)
+        for (int c = 0; c < 3; c++)
+          W[r][c] = ((Rh[r][0] - R[r][0]) * R[c][0] + (Rh[r][1] - R[r][1]) * R[c][1] +
+                     (Rh[r][2] - R[r][2]) * R[c][2]) / h;
+      double w[3] = {W[2][1], W[0][2], W[1][0]};
+      double expected = w[0] * torque[0] + w[1] * torque[1] + w[2] * torque[2];
+      EXPECT_NEAR(expected, gimbal_torque[j], 1e-5) << "pose " << p << " axis " << j;
+    }
+  }
+}
+
+TEST(Kinematics, RollTorqueIsAboutTheStylusAxis)
+{
+  const double joints[3] = {0.3, -0.2, 0.5};
+  const double rot[3] = {0.4, -0.7, 1.1};
+  const double position[3] = {0.0, 0.0, 0.0};
+  double transform[16];
+  stylus_transform(joints, rot, position, transform);
+
+  // A torque about the stylus z axis turns only the roll axis
+  double gimbal_torque[3];
+  gimbal_torques(joints, rot, &transform[8], gimbal_torque);
+  EXPECT_NEAR(1.0, gimbal_torque[2], 1e-12);
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <boost/thread/thread.hpp>
+
+#include "sensable_phantom/lockfree.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+// Every field carries the same value, so a torn copy shows up as a mismatch
+struct Payload
+{
+  unsigned long values[13];
+};
+
+void fill(Payload& p, unsigned long v)
+{
+  for (int i = 0; i < 13; i++)
+    p.values[i] = v;
+}
+
+bool consistent(const Payload& p)
+{
+  for (int i = 1; i < 13; i++)
+    if (p.values[i] != p.values[0])
+      return false;
+  return true;
+}
+
+} // namespace
+
+TEST(Seqlock, StartsZeroedAndCountsStores)
+{
+  Seqlock<Payload> lock;
+  Payload p;
+  unsigned long seq0 = lock.load(p);
+  EXPECT_EQ(0u, p.values[0]);
+  EXPECT_TRUE(consistent(p));
+
+  fill(p, 42);
+  lock.store(p);
+  Payload q;
+  EXPECT_EQ(seq0 + 2, lock.load(q));
+  EXPECT_EQ(42u, q.values[12]);
+}
+
+TEST(Seqlock, ReaderNeverSeesTornCopy)
+{
+  Seqlock<Payload> lock;
+  const unsigned long N = 200000;
+  boost::thread writer([&lock, N]()
+  {
+    Payload p;
+    for (unsigned long v = 1; v <= N; v++)
+    {
+      fill(p, v);
+      lock.store(p);
+    }
+  });
+
+  Payload p;
+  unsigned long last = 0;
+  bool torn = false, backwards = false;
+  do
+  {
+    lock.load(p);
+    torn |= !consistent(p);
+    backwards |= p.values[0] < last;
+    last = p.values[0];
+  } while (last != N);
+  writer.join();
+  EXPECT_FALSE(torn);
+  EXPECT_FALSE(backwards);
+}
+
+TEST(TripleBuffer, ReadsLatestAndReportsFreshness)
+{
+  TripleBuffer<int> buffer;
+  int v = -1;
+  EXPECT_FALSE(buffer.read(v));
+  EXPECT_EQ(0, v);
+
+  buffer.write(1);
+  buffer.write(2);
+  EXPECT_TRUE(buffer.read(v));
+  EXPECT_EQ(2, v);
+  EXPECT_FALSE(buffer.read(v));
+  EXPECT_EQ(2, v);
+
+  buffer.write_slot() = 3;
+  buffer.publish();
+  EXPECT_TRUE(buffer.update());
+  EXPECT_EQ(3, buffer.front());
+  EXPECT_FALSE(buffer.update());
+  EXPECT_EQ(3, buffer.front());
+}
+
+TEST(TripleBuffer, ConsumerSeesCompleteIncreasingValues)
+{
+  TripleBuffer<Payload> buffer;
+  const unsigned long N = 200000;
+  boost::thread producer([&buffer, N]()
+  {
+    for (unsigned long v = 1; v <= N; v++)
+    {
+      fill(buffer.write_slot(), v);
+      buffer.publish();
+    }
+  });
+
+  unsigned long last = 0;
+  bool torn = false, backwards = false;
+  while (last != N)
+  {
+    if (!buffer.update())
+    {
+      boost::this_thread::yield();
+      continue;
+    }
+    const Payload& p = buffer.front();
+    torn |= !consistent(p);
+    backwards |= p.values[0] <= last;
+    last = p.values[0];
+  }
+  producer.join();
+  EXPECT_FALSE(torn);
+  EXPECT_FALSE(backwards);
+}
+
+TEST(SpscRing, FifoAndFull)
+{
+  SpscRing<int, 4> ring;
+  int v;
+  EXPECT_FALSE(ring.pop(v));
+  for (int i = 0; i < 4; i++)
+    EXPECT_TRUE(ring.push(i));
+  EXPECT_FALSE(ring.push(4));
+  EXPECT_EQ(4u, ring.size());
+
+  // Wraps around the end of the buffer
+  for (int round = 0; round < 3; round++)
+  {
+    ASSERT_TRUE(ring.pop(v));
+    EXPECT_EQ(round, v);
+    EXPECT_TRUE(ring.push(4 + round));
+  }
+  for (int i = 3; i < 7; i++)
+  {
+    ASSERT_TRUE(ring.pop(v));
+    EXPECT_EQ(i, v);
+  }
+  EXPECT_EQ(0u, ring.size());
+}
+
+TEST(SpscRing, ConcurrentTransferKeepsOrder)
+{
+  SpscRing<unsigned long, 64> ring;
+  const unsigned long N = 100000;
+  boost::thread producer([&ring, N]()
+  {
+    for (unsigned long v = 0; v < N;)
+    {
+      if (ring.push(v))
+        v++;
+      else
+        boost::this_thread::yield();
+    }
+  });
+
+  unsigned long expected = 0, v;
+  bool ordered = true;
+  while (expected < N)
+  {
+    if (!ring.pop(v))
+    {
+      boost::this_thread::yield();
+      continue;
+    }
+    ordered &= (v == expected);
+    expected++;
+  }
+  producer.join();
+  EXPECT_TRUE(ordered);
+  EXPECT_EQ(0u, ring.size());
+}
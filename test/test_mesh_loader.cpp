@@ -0,0 +1,184 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <string>
+
+#include "sensable_phantom/haptic_mesh.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+// Writes the contents to a temporary file with the given extension, removed on destruction
+class TempFile
+{
+public:
+  TempFile(const std::string& extension, const std::string& contents)
+  {
+    char name[] = "/tmp/test_mesh_loaderXXXXXX";
+    int fd = mkstemp(name);
+    close(fd);
+    unlink(name);
+    path_ = std::string(name) + "." + extension;
+    std::ofstream file(path_.c_str(), std::ios::out | std::ios::binary);
+    file.write(contents.data(), contents.size());
+  }
+
+  ~TempFile()
+  {
+    unlink(path_.c_str());
+  }
+
+  const std::string& path() const
+  {
+    return path_;
+  }
+
+private:
+  std::string path_;
+};
+
+const char *ASCII_HEADER = "ply\nformat ascii 1.0\n";
+
+const char *ASCII_QUAD =
+    "ply\n"
+    "format ascii 1.0\n"
+    "element vertex 4\n"
+    "property float x\n"
+    "property float y\n"
+    "property float z\n"
+    "element face 1\n"
+    "property list uchar int vertex_indices\n"
+    "end_header\n"
+    "0 0 0\n"
+    "1 0 0\n"
+    "1 1 0\n"
+    "0 1 0\n"
+    "4 0 1 2 3\n";
+
+std::string binary_ply(const std::string& elements)
+{
+  return "ply\nformat binary_little_endian 1.0\n" + elements + "end_header\n";
+}
+
+template <typename T>
+void append(std::string& data, T value)
+{
+  data.append((const char *)&value, sizeof(value));
+}
+
+int load(const std::string& extension, const std::string& contents, TriangleMesh& mesh)
+{
+  TempFile file(extension, contents);
+  return load_mesh(file.path(), mesh);
+}
+
+} // namespace
+
+TEST(MeshLoader, LoadsAsciiPly)
+{
+  TriangleMesh mesh;
+  ASSERT_EQ(0, load("ply", ASCII_QUAD, mesh));
+  EXPECT_EQ(12u, mesh.vertices.size());
+  ASSERT_EQ(2u, mesh.triangles());
+  const uint32_t fan[6] = {0, 1, 2, 0, 2, 3};
+  for (int i = 0; i < 6; i++)
+    EXPECT_EQ(fan[i], mesh.indices[i]);
+  EXPECT_EQ(1.0f, mesh.vertices[3 * 2 + 1]);
+}
+
+TEST(MeshLoader, LoadsBinaryStl)
+{
+  std::string data(80, ' ');
+  append<uint32_t>(data, 1);
+  for (int i = 0; i < 12; i++)
+    append<float>(data, i < 3 ? 0.0f : (float)i);
+  append<uint16_t>(data, 0);
+
+  TriangleMesh mesh;
+  ASSERT_EQ(0, load("stl", data, mesh));
+  EXPECT_EQ(1u, mesh.triangles());
+}
+
+TEST(MeshLoader, RejectsImpossibleElementCounts)
+{
+  TriangleMesh mesh;
+  const char *counts[] = {"-1", "18446744073709551615", "1000000000000", "nan", "x"};
+  for (int i = 0; i < 5; i++)
+  {
+    std::string header = std::string(ASCII_HEADER) + "element vertex " + counts[i] +
+                         "\nproperty float x\nproperty float y\nproperty float z\nend_header\n0 0 0\n";
+    EXPECT_EQ(-1, load("ply", header, mesh)) << counts[i];
+  }
+
+  // A billion binary vertices do not fit in a few bytes
+  std::string data =
+      binary_ply("element vertex 1000000000\nproperty float x\nproperty float y\nproperty float z\n");
+  append<float>(data, 0.0f);
+  EXPECT_EQ(-1, load("ply", data, mesh));
+
+  // Nor does an element with no properties to read
+  EXPECT_EQ(-1, load("ply", std::string(ASCII_HEADER) + "element vertex 1000000000\nend_header\n", mesh));
+}
+
+TEST(MeshLoader, RejectsBadListCounts)
+{
+  TriangleMesh mesh;
+  const char *lengths[] = {"-3", "1e12", "2.5", "nan", "inf"};
+  for (int i = 0; i < 5; i++)
+  {
+    std::string text(ASCII_QUAD);
+    text.replace(text.rfind("4 0 1 2 3"), 1, lengths[i]);
+    EXPECT_EQ(-1, load("ply", text, mesh)) << lengths[i];
+  }
+
+  // Non-finite binary list length
+  std::string data = binary_ply("element vertex 1\nproperty float x\nproperty float y\nproperty float z\n"
+                                "element face 1\nproperty list float int vertex_indices\n");
+  for (int i = 0; i < 3; i++)
+    append<float>(data, 0.0f);
+  append<float>(data, 1.0f / 0.0f);
+  append<int32_t>(data, 0);
+  EXPECT_EQ(-1, load("ply", data, mesh));
+}
+
+TEST(MeshLoader, RejectsBadVertexIndices)
+{
+  TriangleMesh mesh;
+  const char *faces[] = {"3 0 1 4", "3 0 -1 2", "3 0 1 2.5e9"};
+  for (int i = 0; i < 3; i++)
+  {
+    std::string text(ASCII_QUAD);
+    text.replace(text.rfind("4 0 1 2 3"), 9, faces[i]);
+    EXPECT_EQ(-1, load("ply", text, mesh)) << faces[i];
+  }
+}
+
+TEST(MeshLoader, RejectsTruncatedFiles)
+{
+  TriangleMesh mesh;
+  std::string text(ASCII_QUAD);
+  EXPECT_EQ(-1, load("ply", text.substr(0, text.size() - 4), mesh));
+  EXPECT_EQ(-1, load("ply", text.substr(0, text.find("end_header")), mesh));
+
+  std::string data(80, ' ');
+  append<uint32_t>(data, 1000000);
+  EXPECT_EQ(-1, load("stl", data, mesh));
+}
+
+TEST(MeshLoader, RejectsUnknownFormats)
+{
+  TriangleMesh mesh;
+  EXPECT_EQ(-1, load("obj", ASCII_QUAD, mesh));
+  EXPECT_EQ(-1, load_mesh("/nonexistent/mesh.ply", mesh));
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/weak_ptr.hpp>
+
+#include "sensable_phantom/message_pool.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+// Shaped like a stamped message: a constant frame id and a variable payload
+struct Message
+{
+  std::string frame_id;
+  std::vector<double> values;
+  unsigned long seq;
+};
+
+Message prototype()
+{
+  Message message;
+  message.frame_id = "a_frame_id_too_long_for_the_small_string_buffer";
+  message.values.resize(6);
+  message.seq = 0;
+  return message;
+}
+
+// Stands in for the publisher queue, holding the last few messages
+const size_t QUEUE_DEPTH = 4;
+
+} // namespace
+
+// Allocations of the whole publish path are counted in test_publish_allocations.cpp
+TEST(MessagePool, SteadyStatePublishingRecyclesMessages)
+{
+  MessagePool<Message> pool;
+  pool.init(8, prototype(), 16);
+  boost::shared_ptr<Message> queue[QUEUE_DEPTH];
+
+  // Warm up, then recycle
+  for (unsigned long k = 0; k < 100; k++)
+    queue[k % QUEUE_DEPTH] = pool.acquire();
+
+  for (unsigned long k = 0; k < 10000; k++)
+  {
+    boost::shared_ptr<Message> message = pool.acquire();
+    message->seq = k;
+    for (size_t i = 0; i < message->values.size(); i++)
+      message->values[i] = k + i;
+    queue[k % QUEUE_DEPTH] = message;
+  }
+
+  EXPECT_EQ(0u, pool.misses());
+  EXPECT_EQ(8u, pool.size());
+}
+
+TEST(MessagePool, RecycledMessagesKeepConstantFields)
+{
+  MessagePool<Message> pool;
+  pool.init(2, prototype(), 2);
+  for (int k = 0; k < 10; k++)
+  {
+    boost::shared_ptr<Message> message = pool.acquire();
+    EXPECT_EQ(prototype().frame_id, message->frame_id);
+    message->seq = k;
+  }
+}
+
+TEST(MessagePool, GrowsUpToItsCap)
+{
+  MessagePool<Message> pool;
+  pool.init(2, prototype(), 4);
+  EXPECT_EQ(4u, pool.max_size());
+
+  // A subscriber that never lets go
+  std::vector<boost::shared_ptr<Message> > held;
+  for (int k = 0; k < 4; k++)
+    held.push_back(pool.acquire());
+  EXPECT_EQ(4u, pool.size());
+  EXPECT_EQ(2u, pool.misses());
+  EXPECT_EQ(0u, pool.overflows());
+
+  // Past the cap, messages are handed out but not kept
+  for (int k = 0; k < 10; k++)
+  {
+    boost::shared_ptr<Message> message = pool.acquire();
+    EXPECT_EQ(prototype().frame_id, message->frame_id);
+    boost::weak_ptr<Message> weak = message;
+    message.reset();
+    EXPECT_TRUE(weak.expired());
+  }
+  EXPECT_EQ(4u, pool.size());
+  EXPECT_EQ(12u, pool.misses());
+  EXPECT_EQ(10u, pool.overflows());
+
+  // Once the subscriber lets go, the pool is reused without allocating
+  held.clear();
+  for (int k = 0; k < 100; k++)
+    pool.acquire();
+  EXPECT_EQ(4u, pool.size());
+  EXPECT_EQ(12u, pool.misses());
+}
+
+TEST(MessagePool, CapBelowInitialSizeKeepsTheInitialMessages)
+{
+  MessagePool<Message> pool;
+  pool.init(4, prototype(), 0);
+  EXPECT_EQ(4u, pool.size());
+  EXPECT_EQ(4u, pool.max_size());
+}
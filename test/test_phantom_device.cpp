@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include "sensable_phantom/phantom_device.h"
+
+using namespace sensable_phantom;
+
+namespace
+{
+
+DeviceOutput output()
+{
+  DeviceOutput out = {{1.0, 2.0, 3.0}, {0.1, -0.2, 0.3}, {0.05, 0.4, -0.6}};
+  return out;
+}
+
+} // namespace
+
+// HD_CURRENT_TORQUE, 3-DoF devices
+TEST(HDTorque, CartesianTorqueIsSentInMilliNewtonMeters)
+{
+  double torque_mnm[3];
+  hd_torque(output(), false, false, torque_mnm);
+  EXPECT_DOUBLE_EQ(100.0, torque_mnm[0]);
+  EXPECT_DOUBLE_EQ(-200.0, torque_mnm[1]);
+  EXPECT_DOUBLE_EQ(300.0, torque_mnm[2]);
+}
+
+// HD_CURRENT_GIMBAL_TORQUE, 6-DoF devices; it was always scaled
+TEST(HDTorque, GimbalTorqueIsSentInMilliNewtonMeters)
+{
+  for (int legacy = 0; legacy < 2; legacy++)
+  {
+    double torque_mnm[3];
+    hd_torque(output(), true, legacy, torque_mnm);
+    EXPECT_DOUBLE_EQ(50.0, torque_mnm[0]) << "legacy " << legacy;
+    EXPECT_DOUBLE_EQ(400.0, torque_mnm[1]) << "legacy " << legacy;
+    EXPECT_DOUBLE_EQ(-600.0, torque_mnm[2]) << "legacy " << legacy;
+  }
+}
+
+TEST(HDTorque, LegacyUnitsPassCartesianTorqueThrough)
+{
+  double torque_mnm[3];
+  hd_torque(output(), false, true, torque_mnm);
+  EXPECT_DOUBLE_EQ(0.1, torque_mnm[0]);
+  EXPECT_DOUBLE_EQ(-0.2, torque_mnm[1]);
+  EXPECT_DOUBLE_EQ(0.3, torque_mnm[2]);
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * PhantomROS on the simulated device, run by rostest since init() talks to
+ * the master. Frames are looked up in a local tf::Transformer and the servo
+ * loop is not scheduled, so the tests call the callbacks themselves.
+ */
+
+#include <gtest/gtest.h>
+
+#include <arpa/inet.h>
+#include <math.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <string>
+
+#include <ros/ros.h>
+#include <tf/tf.h>
+
+#include "sensable_phantom/phantom_ros.h"
+#include "sensable_phantom/phantom_state.h"
+#include "sensable_phantom/sim_backend.h"
+
+namespace sensable_phantom
+{
+
+class PhantomROSTest : public ::testing::Test
+{
+protected:
+  PhantomROSTest() : backend_((SimConfig())), phantom_ros_(transformer_)
+  {
+  }
+
+  void SetUp()
+  {
+    state_.device = backend_.open("");
+    state_.servo_rate = backend_.update_rate();
+    // Every test reads its settings from its own private namespace
+    pnode_ = ros::NodeHandle(std::string("~") + ::testing::UnitTest::GetInstance()->current_test_info()->name());
+  }
+
+  // base_link -> link_0 -> sensable_origin, as the node sends them to /tf_static
+  void add_frames(const std::string& tf_prefix)
+  {
+    ros::Time stamp(1.0);
+    tf::Transform l0(tf::createIdentityQuaternion(), tf::Vector3(0, 0, 0.135));
+    tf::Transform sensable(tf::createQuaternionFromRPY(M_PI / 2, 0, -M_PI / 2), tf::Vector3(-0.2, 0, 0));
+    transformer_.setTransform(tf::StampedTransform(l0, stamp, tf::resolve(tf_prefix, "base_link"),
+                                                   tf::resolve(tf_prefix, "link_0")));
+    transformer_.setTransform(tf::StampedTransform(sensable, stamp, tf::resolve(tf_prefix, "link_0"),
+                                                   tf::resolve(tf_prefix, "sensable_origin")));
+  }
+
+  int init()
+  {
+    return phantom_ros_.init(&state_, node_, pnode_);
+  }
+
+  // A UDP port nobody listens on
+  static int free_port()
+  {
+    int probe = socket(AF_INET, SOCK_DGRAM, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(probe, (struct sockaddr *)&addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(probe, (struct sockaddr *)&addr, &len);
+    close(probe);
+    return ntohs(addr.sin_port);
+  }
+
+  // Latest servo sample moving at velocity, mm/s
+  void set_velocity(double vx, double vy, double vz)
+  {
+    PhantomSample sample;
+    state_.sample.load(sample);
+    sample.velocity[0] = vx;
+    sample.velocity[1] = vy;
+    sample.velocity[2] = vz;
+    state_.sample.store(sample);
+  }
+
+  // Hands a wrench to wrench_callback, returns the force sent to the servo loop
+  void send_force(const std::string& frame_id, double fx, double fy, double fz, double force[3])
+  {
+    geometry_msgs::WrenchStampedPtr wrench(new geometry_msgs::WrenchStamped);
+    wrench->header.frame_id = frame_id;
+    wrench->wrench.force.x = fx;
+    wrench->wrench.force.y = fy;
+    wrench->wrench.force.z = fz;
+    phantom_ros_.wrench_callback(wrench);
+    PhantomCommand command;
+    ASSERT_TRUE(state_.command.read(command));
+    memcpy(force, command.force, sizeof(command.force));
+  }
+
+  double damping_k() const
+  {
+    return phantom_ros_.damping_k_;
+  }
+
+  tf::Transformer transformer_;
+  SimBackend backend_;
+  PhantomState state_;
+  ros::NodeHandle node_;
+  ros::NodeHandle pnode_;
+  PhantomROS phantom_ros_;
+};
+
+// damping_k has been N/(mm/s) all along, and so has the velocity it multiplies
+TEST_F(PhantomROSTest, DefaultDampingIsOneMilliNewtonPerMillimeterPerSecond)
+{
+  add_frames("");
+  ASSERT_EQ(0, init());
+  EXPECT_DOUBLE_EQ(0.001, damping_k());
+
+  set_velocity(100.0, 0.0, -50.0);
+  double force[3];
+  send_force("sensable_origin", 0.0, 0.0, 0.0, force);
+  EXPECT_NEAR(-0.1, force[0], 1e-12);
+  EXPECT_NEAR(0.0, force[1], 1e-12);
+  EXPECT_NEAR(0.05, force[2], 1e-12);
+}
+
+// Remote forces get the same damping in the servo loop
+TEST_F(PhantomROSTest, RemoteForcesGetTheSameDamping)
+{
+  pnode_.setParam("command_port", free_port());
+  add_frames("");
+  ASSERT_EQ(0, init());
+  EXPECT_DOUBLE_EQ(damping_k(), state_.command_damping);
+  EXPECT_NEAR(0.1, state_.command_damping * 100.0, 1e-12);
+}
+
+// 40 N/m and 1 Ns/m are the 0.04 N/mm and 0.001 N/(mm/s) the lock always had
+TEST_F(PhantomROSTest, DefaultLockGainsAreTheBaselineGains)
+{
+  add_frames("");
+  ASSERT_EQ(0, init());
+  state_.lock_gains.update();
+  const LockGains& gains = state_.lock_gains.front();
+  EXPECT_DOUBLE_EQ(0.04, gains.stiffness);
+  EXPECT_DOUBLE_EQ(0.001, gains.damping);
+  EXPECT_DOUBLE_EQ(LockGains().damping, gains.damping);
+}
+
+// Several devices share /tf, so each rotates into its own sensable_origin
+TEST_F(PhantomROSTest, PrefixedFramesRotateIntoThePrefixedSensableOrigin)
+{
+  pnode_.setParam("tf_prefix", "left");
+  add_frames("left");
+  ASSERT_EQ(0, init());
+
+  double force[3];
+  send_force("left/sensable_origin", 1.0, 2.0, 3.0, force);
+  EXPECT_NEAR(1.0, force[0], 1e-12);
+  EXPECT_NEAR(2.0, force[1], 1e-12);
+  EXPECT_NEAR(3.0, force[2], 1e-12);
+
+  // base_link x, y, z are -z, -x, y of sensable_origin
+  send_force("left/base_link", 1.0, 2.0, 3.0, force);
+  EXPECT_NEAR(-2.0, force[0], 1e-9);
+  EXPECT_NEAR(3.0, force[1], 1e-9);
+  EXPECT_NEAR(-1.0, force[2], 1e-9);
+}
+
+} // namespace sensable_phantom
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_phantom_ros");
+  ros::NodeHandle node;
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+/*
+ * Publishing must not allocate once the message pools are warm. The global
+ * operator new is replaced to count, so this test is an executable of its
+ * own; it runs under rostest since PhantomROS::init() talks to the master.
+ */
+
+#include <gtest/gtest.h>
+
+#include <stdlib.h>
+
+#include <new>
+
+#include <ros/ros.h>
+#include <tf/tf.h>
+
+#include "sensable_phantom/phantom_ros.h"
+#include "sensable_phantom/phantom_state.h"
+#include "sensable_phantom/sim_backend.h"
+
+// Allocations of the thread under test; roscpp's own threads are not counted
+static thread_local unsigned long allocations = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+// Not inlined, so the compiler never sees free() applied to the result of new
+__attribute__((noinline)) void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+__attribute__((noinline)) void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+using namespace sensable_phantom;
+
+// The publisher thread of a node with the sample stream on, fed by the
+// simulated servo loop at 100 Hz
+TEST(PublishAllocations, SteadyStatePublishingDoesNotAllocate)
+{
+  SimBackend backend((SimConfig()));
+  PhantomState state;
+  state.device = backend.open("");
+  state.servo_rate = backend.update_rate();
+
+  ros::NodeHandle node("phantom");
+  ros::NodeHandle pnode("~");
+  pnode.setParam("batch_size", 10);
+  tf::Transformer transformer;
+  PhantomROS phantom_ros(transformer);
+  ASSERT_EQ(0, phantom_ros.init(&state, node, pnode));
+
+  // Warm up for the first second, then count the publisher side only
+  const int WARM_UP_TICKS = 1000;
+  unsigned long counted = 0;
+  for (int k = 0; k < 5 * WARM_UP_TICKS; k++)
+  {
+    phantom_state_callback(&state);
+    if (k % 10)
+      continue;
+
+    PhantomSample sample;
+    state.sample.load(sample);
+    unsigned long before = allocations;
+    phantom_ros.publish_sample(sample);
+    phantom_ros.publish_batches();
+    if (k >= WARM_UP_TICKS)
+      counted += allocations - before;
+  }
+
+  EXPECT_EQ(0u, counted);
+  EXPECT_EQ(0u, state.batch_dropped.load());
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  ros::init(argc, argv, "test_publish_allocations");
+  ros::NodeHandle node;
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2013, Boris Gromov, BioRobotics Lab at KoreaTech
+ * All right reserved.
+ */
+
+#include <gtest/gtest.h>
+
+#include <math.h>
+
+#include "sensable_phantom/velocity_filter.h"
+
+using namespace sensable_phantom;
+
+TEST(VelocityFilter, RejectsBadConfiguration)
+{
+  VelocityFilter filter;
+  EXPECT_EQ(-1, filter.configure(0, 20.0, 1000.0));
+  EXPECT_EQ(-1, filter.configure(VelocityFilter::MAX_ORDER + 1, 20.0, 1000.0));
+  EXPECT_EQ(-1, filter.configure(3, 500.0, 1000.0));
+  EXPECT_EQ(-1, filter.configure(3, -1.0, 1000.0));
+  EXPECT_EQ(0, filter.configure(VelocityFilter::MAX_ORDER, 20.0, 1000.0));
+}
+
+// Positions in mm come out as mm/s, whatever the order and rate
+TEST(VelocityFilter, RampSettlesToSlopeInMillimetersPerSecond)
+{
+  const int orders[] = {1, 3, 8};
+  const double rates[] = {500.0, 1000.0};
+  for (int o = 0; o < 3; o++)
+  {
+    for (int r = 0; r < 2; r++)
+    {
+      VelocityFilter filter;
+      ASSERT_EQ(0, filter.configure(orders[o], 20.0, rates[r]));
+      const double slope[3] = {100.0, -50.0, 0.0}; // mm/s
+      double position[3], velocity[3];
+      for (int k = 0; k < (int)rates[r]; k++)
+      {
+        for (int i = 0; i < 3; i++)
+          position[i] = 10.0 + slope[i] * k / rates[r];
+        filter.step(position, velocity);
+      }
+      for (int i = 0; i < 3; i++)
+        EXPECT_NEAR(slope[i], velocity[i], 1e-6) << "order " << orders[o] << " at " << rates[r] << " Hz";
+    }
+  }
+}
+
+// A loop configured for 1 kHz that actually runs at 900 Hz still reports
+// mm/s once the filter differentiates at the measured rate
+TEST(VelocityFilter, DifferencesFollowTheMeasuredRate)
+{
+  VelocityFilter nominal, measured;
+  ASSERT_EQ(0, nominal.configure(3, 20.0, 1000.0));
+  ASSERT_EQ(0, measured.configure(3, 20.0, 1000.0));
+  measured.set_sample_rate(900.0);
+
+  const double slope = 100.0; // mm/s
+  double position[3] = {0.0, 0.0, 0.0}, nominal_velocity[3], measured_velocity[3];
+  for (int k = 0; k < 900; k++)
+  {
+    position[0] = slope * k / 900.0;
+    nominal.step(position, nominal_velocity);
+    measured.step(position, measured_velocity);
+  }
+  EXPECT_NEAR(slope, measured_velocity[0], 1e-6);
+  EXPECT_NEAR(slope * 1000.0 / 900.0, nominal_velocity[0], 1e-6);
+
+  // Not a rate, ignored
+  measured.set_sample_rate(0.0);
+  position[0] = slope;
+  measured.step(position, measured_velocity);
+  EXPECT_NEAR(slope, measured_velocity[0], 1e-6);
+}
+
+TEST(VelocityFilter, StartsFromRest)
+{
+  VelocityFilter filter;
+  double position[3] = {120.0, -80.0, 45.0}, velocity[3];
+  filter.step(position, velocity);
+  for (int i = 0; i < 3; i++)
+    EXPECT_EQ(0.0, velocity[i]);
+}
+
+TEST(VelocityFilter, StepResponseIsLowPassed)
+{
+  VelocityFilter filter;
+  ASSERT_EQ(0, filter.configure(3, 20.0, 1000.0));
+  double position[3] = {0.0, 0.0, 0.0}, velocity[3];
+  filter.step(position, velocity);
+
+  // A 1 mm jump is a 1000 mm/s spike for the difference; the filter spreads
+  // it out, and the velocity dies away once the stylus stops
+  position[0] = 1.0;
+  double peak = 0.0, area = 0.0;
+  for (int k = 0; k < 1000; k++)
+  {
+    filter.step(position, velocity);
+    peak = fmax(peak, fabs(velocity[0]));
+    area += velocity[0] / 1000.0;
+  }
+  EXPECT_LT(peak, 200.0);
+  EXPECT_NEAR(1.0, area, 1e-3); // integrates back to the displacement, mm
+  EXPECT_NEAR(0.0, velocity[0], 1e-6);
+  EXPECT_EQ(0.0, velocity[1]);
+}